@@ -1,8 +1,11 @@
 #pragma once
 
 #include <CLI/CLI.hpp>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <vector>
 
 struct Arguments {
     std::string repo_path;
@@ -13,11 +16,41 @@ struct Arguments {
     bool output_json{false};
     bool debug{false};
     bool scrub_comments{false};
+    bool minify_whitespace{false};
+    bool outline{false};
+    std::vector<std::string> full_globs;   // with --outline, files matching these stay complete
     bool verbose{false};
     std::string gptignore_file;
 
+    // Only include files with a line matching one of these regexes; with --context,
+    // only the matching lines and grep_context lines around them
+    std::vector<std::string> grep_patterns;
+    bool grep_hunks{false};
+    std::size_t grep_context{0};
+
+    // Per-file size limits (0 = unlimited) and which part of a large file to keep
+    std::uint64_t max_file_bytes{0};
+    std::uint64_t max_file_lines{0};
+    std::string truncate_policy{"head"};
+
+    // What to do with files that aren't UTF-8: transcode, replace or skip
+    std::string encoding_policy{"transcode"};
+
+    // How symbolic links are handled while scanning: skip, files or follow
+    std::string symlinks{"files"};
+
     // NEW: If true, read file paths from STDIN instead of scanning the repo
     bool stdin_file_list{false};
+
+    // Only emit files changed against the index, or against changed_ref if set
+    bool changed{false};
+    std::string changed_ref;
+    std::size_t changed_context{0};
+
+    // Rank files against a free-text query (BM25) and stop at a token budget (0 = none)
+    std::string query;
+    std::string index_cache;
+    std::uint64_t token_budget{0};
 };
 
 inline std::optional<Arguments> parse_arguments(CLI::App& app, int argc, char** argv) {
@@ -32,12 +65,55 @@ inline std::optional<Arguments> parse_arguments(CLI::App& app, int argc, char**
     app.add_flag("-j,--json", args.output_json, "Output JSON");
     app.add_flag("-d,--debug", args.debug, "Debug mode (no output to stdout)");
     app.add_flag("-s,--scrub-comments", args.scrub_comments, "Scrub comments from the output");
+    app.add_flag("-m,--minify-whitespace", args.minify_whitespace,
+                 "Strip trailing whitespace and collapse blank lines");
+    app.add_flag("--outline", args.outline,
+                 "Keep only declarations, signatures and doc summaries of source files");
+    app.add_option("--full", args.full_globs,
+                   "With --outline, keep files matching this glob complete (repeatable)")
+        ->allow_extra_args(false);
     app.add_flag("-v,--verbose", args.verbose, "Enable verbose logging");
 
+    app.add_option("--grep", args.grep_patterns,
+                   "Only include files with a line matching this regular expression (repeatable)")
+        ->allow_extra_args(false);
+    auto* context_opt = app.add_option("-C,--context", args.grep_context,
+                   "With --grep, emit only matching lines and N lines around them, with line numbers");
+
+    app.add_option("--max-file-bytes", args.max_file_bytes,
+                   "Truncate files larger than this many bytes (0 = no limit)");
+    app.add_option("--max-file-lines", args.max_file_lines,
+                   "Truncate files longer than this many lines (0 = no limit)");
+    app.add_option("--truncate", args.truncate_policy,
+                   "Which part of a truncated file to keep: head, tail or head-tail")
+        ->check(CLI::IsMember({"head", "tail", "head-tail"}));
+
+    app.add_option("--encoding-policy", args.encoding_policy,
+                   "Files that aren't UTF-8: transcode them, replace invalid bytes, or skip them")
+        ->check(CLI::IsMember({"transcode", "replace", "skip"}));
+    app.add_option("--symlinks", args.symlinks,
+                   "Symbolic links: skip them, include linked files, or follow linked directories too")
+        ->check(CLI::IsMember({"skip", "files", "follow"}));
+
     // NEW FLAG for reading file paths from STDIN
     app.add_flag("--stdin-file-list", args.stdin_file_list,
                  "Read filenames from STDIN instead of scanning the entire repo.");
 
+    // --changed takes an optional revision, so `--changed=<ref>` or putting the
+    // repo path first avoids the path being taken as the revision.
+    auto* changed_opt = app.add_option("--changed", args.changed_ref,
+                   "Only include files changed against the Git index, or against <ref> if given")
+        ->expected(0, 1);
+    app.add_option("--changed-context", args.changed_context,
+                   "With --changed, also include N unchanged files from the nearest directories");
+
+    app.add_option("-q,--query", args.query,
+                   "Only include files relevant to this text, most relevant first");
+    app.add_option("--index-cache", args.index_cache,
+                   "With --query, keep the search index in this file and reuse it for unchanged files");
+    app.add_option("--token-budget", args.token_budget,
+                   "Skip files once the estimated token count would exceed this budget");
+
     // Positional: repository path (still required)
     app.add_option("repo_path", args.repo_path, "Path to the Git repository")->required();
 
@@ -50,6 +126,8 @@ inline std::optional<Arguments> parse_arguments(CLI::App& app, int argc, char**
             return std::nullopt;
         }
     }
+    args.changed = changed_opt->count() > 0;
+    args.grep_hunks = context_opt->count() > 0;
 
     return args;
 }
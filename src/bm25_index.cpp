@@ -0,0 +1,365 @@
+#include "bm25_index.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char kMagic[8] = {'G', '2', 'P', 'B', 'M', '2', '5', '2'};
+// Stored in the cache header: bump it whenever bm25_terms() changes, so
+// postings built by an older tokenizer are not reused
+constexpr std::uint32_t kTokenizerVersion = 1;
+constexpr double kK1 = 1.2;
+constexpr double kB = 0.75;
+constexpr std::uint32_t kPathWeight = 3;   // a path term counts like 3 occurrences in the content
+constexpr size_t kMaxTermLength = 64;
+
+bool is_word_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+bool is_upper(char c) { return c >= 'A' && c <= 'Z'; }
+bool is_lower(char c) { return c >= 'a' && c <= 'z'; }
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+template <class Fn>
+void emit_term(std::string_view word, std::string& buf, Fn& fn) {
+    if(word.size() < 2 || word.size() > kMaxTermLength ||
+       std::all_of(word.begin(), word.end(), is_digit)) {
+        return;
+    }
+    buf.assign(word);
+    for(auto& c : buf) {
+        if(is_upper(c)) c = static_cast<char>(c - 'A' + 'a');
+    }
+    fn(std::string_view(buf));
+}
+
+/// Call fn(term) for every term of text (whole words and their sub-words)
+template <class Fn>
+void for_each_term(std::string_view text, Fn&& fn) {
+    std::string buf;
+    size_t i = 0;
+    while(i < text.size()) {
+        if(!is_word_char(text[i])) {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while(i < text.size() && is_word_char(text[i])) i++;
+        std::string_view word = text.substr(start, i - start);
+        emit_term(word, buf, fn);
+
+        // Sub-words split on '_', lower->Upper, letter<->digit and "HTTPServer" -> HTTP|Server
+        size_t part = 0;
+        bool split = false;
+        for(size_t j = 1; j <= word.size(); j++) {
+            bool boundary = j == word.size() || word[j] == '_' || word[j - 1] == '_';
+            if(!boundary) {
+                char a = word[j - 1], b = word[j];
+                boundary = (is_lower(a) && is_upper(b)) ||
+                           (is_digit(a) != is_digit(b)) ||
+                           (is_upper(a) && is_upper(b) && j + 1 < word.size() && is_lower(word[j + 1]));
+            }
+            if(!boundary) continue;
+            if(j < word.size()) split = true;
+            if(split || part > 0) {
+                auto piece = word.substr(part, j - part);
+                if(!piece.empty() && piece[0] != '_') emit_term(piece, buf, fn);
+            }
+            part = (j < word.size() && word[j] == '_') ? j + 1 : j;
+        }
+    }
+}
+
+void put_u32(std::ostream& os, std::uint32_t v) {
+    char b[4];
+    for(int i = 0; i < 4; i++) b[i] = static_cast<char>(v >> (8 * i));
+    os.write(b, 4);
+}
+void put_u64(std::ostream& os, std::uint64_t v) {
+    put_u32(os, static_cast<std::uint32_t>(v));
+    put_u32(os, static_cast<std::uint32_t>(v >> 32));
+}
+void put_str(std::ostream& os, const std::string& s) {
+    put_u32(os, static_cast<std::uint32_t>(s.size()));
+    os.write(s.data(), static_cast<std::streamsize>(s.size()));
+}
+bool get_u32(std::istream& is, std::uint32_t& v) {
+    unsigned char b[4];
+    if(!is.read(reinterpret_cast<char*>(b), 4)) return false;
+    v = std::uint32_t(b[0]) | (std::uint32_t(b[1]) << 8) | (std::uint32_t(b[2]) << 16) | (std::uint32_t(b[3]) << 24);
+    return true;
+}
+bool get_u64(std::istream& is, std::uint64_t& v) {
+    std::uint32_t lo, hi;
+    if(!get_u32(is, lo) || !get_u32(is, hi)) return false;
+    v = (std::uint64_t(hi) << 32) | lo;
+    return true;
+}
+bool get_str(std::istream& is, std::string& s) {
+    std::uint32_t len;
+    if(!get_u32(is, len) || len > (1u << 20)) return false;
+    s.resize(len);
+    return static_cast<bool>(is.read(s.data(), len));
+}
+
+} // namespace
+
+std::vector<std::string> bm25_terms(std::string_view text) {
+    std::vector<std::string> terms;
+    for_each_term(text, [&](std::string_view t) { terms.emplace_back(t); });
+    return terms;
+}
+
+void Bm25Index::build(const std::vector<Bm25Source>& sources, const Bm25Index* previous, unsigned threads,
+                      EncodingPolicy encoding) {
+    docs_.assign(sources.size(), Bm25Doc{});
+    postings_.clear();
+    reused_ = 0;
+    encoding_ = encoding;
+    contents_.assign(retain_terms_.empty() ? 0 : sources.size(), std::nullopt);
+
+    // 1. Stat every file and decide which previous documents can be reused
+    std::unordered_map<std::string_view, std::uint32_t> previous_ids;
+    if(previous) {
+        for(std::uint32_t i = 0; i < previous->docs_.size(); i++) {
+            previous_ids.emplace(previous->docs_[i].path, i);
+        }
+    }
+    std::vector<std::uint32_t> remap(previous ? previous->docs_.size() : 0, UINT32_MAX);
+    std::vector<std::uint32_t> pending;
+    for(std::uint32_t i = 0; i < sources.size(); i++) {
+        auto& doc = docs_[i];
+        doc.path = sources[i].path;
+        std::error_code ec;
+        doc.size = fs::file_size(sources[i].file, ec);
+        auto mtime = fs::last_write_time(sources[i].file, ec);
+        doc.mtime = ec ? 0 : static_cast<std::int64_t>(mtime.time_since_epoch().count());
+
+        auto it = previous_ids.find(doc.path);
+        if(it != previous_ids.end()) {
+            const auto& old = previous->docs_[it->second];
+            if(!ec && old.size == doc.size && old.mtime == doc.mtime) {
+                doc.length = old.length;
+                remap[it->second] = i;
+                reused_++;
+                continue;
+            }
+        }
+        pending.push_back(i);
+    }
+
+    // 2. Carry over postings of reused documents
+    if(previous && reused_ > 0) {
+        for(const auto& [term, list] : previous->postings_) {
+            std::vector<Bm25Posting> kept;
+            for(const auto& p : list) {
+                if(remap[p.doc] != UINT32_MAX) kept.push_back({remap[p.doc], p.tf});
+            }
+            if(!kept.empty()) postings_.emplace(term, std::move(kept));
+        }
+    }
+
+    // 3. Tokenize the remaining files in parallel, one postings map per thread
+    using Postings = std::unordered_map<std::string, std::vector<Bm25Posting>>;
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(pending.size())));
+    std::vector<Postings> local(threads);
+    std::atomic<size_t> next{0};
+    auto worker = [&](unsigned t) {
+        std::unordered_map<std::string, std::uint32_t> tf;
+        std::string content;
+        for(size_t k = next++; k < pending.size(); k = next++) {
+            const std::uint32_t id = pending[k];
+            tf.clear();
+            std::uint32_t length = 0;
+            auto count = [&](std::uint32_t weight) {
+                return [&, weight](std::string_view term) {
+                    auto it = tf.find(std::string(term));
+                    if(it == tf.end()) it = tf.emplace(term, 0).first;
+                    it->second += weight;
+                    length += weight;
+                };
+            };
+            for_each_term(docs_[id].path, count(kPathWeight));
+
+            std::ifstream ifs(sources[id].file, std::ios::binary);
+            if(ifs) {
+                content.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+                // A file the policy skips is still found by its path (and dropped when it is read)
+                if(normalize_encoding(content, encoding)) {
+                    for_each_term(content, count(1));
+                    if(!contents_.empty() && std::any_of(retain_terms_.begin(), retain_terms_.end(),
+                                                         [&](const std::string& term) { return tf.count(term); })) {
+                        contents_[id] = std::move(content);
+                        content.clear();
+                    }
+                }
+            } else {
+                spdlog::warn("Could not open file for indexing: {}", docs_[id].path);
+            }
+            docs_[id].length = length;
+            for(const auto& [term, n] : tf) {
+                local[t][term].push_back({id, n});
+            }
+        }
+    };
+    if(!pending.empty()) {
+        std::vector<std::thread> pool;
+        for(unsigned t = 1; t < threads; t++) {
+            pool.emplace_back(worker, t);
+        }
+        worker(0);
+        for(auto& th : pool) {
+            th.join();
+        }
+    }
+
+    // 4. Merge per-thread postings
+    for(auto& postings : local) {
+        for(auto& [term, list] : postings) {
+            auto& dst = postings_[term];
+            dst.insert(dst.end(), list.begin(), list.end());
+        }
+    }
+    spdlog::debug("Indexed {} files ({} reused, {} terms)", docs_.size(), reused_, postings_.size());
+}
+
+void Bm25Index::retain_contents(std::string_view query) {
+    retain_terms_ = bm25_terms(query);
+    std::sort(retain_terms_.begin(), retain_terms_.end());
+    retain_terms_.erase(std::unique(retain_terms_.begin(), retain_terms_.end()), retain_terms_.end());
+}
+
+std::optional<std::string> Bm25Index::take_content(std::uint32_t doc) {
+    if(doc >= contents_.size() || !contents_[doc]) {
+        return std::nullopt;
+    }
+    auto content = std::move(contents_[doc]);
+    contents_[doc].reset();
+    return content;
+}
+
+std::vector<std::pair<std::uint32_t, double>> Bm25Index::search(std::string_view query) const {
+    std::vector<std::pair<std::uint32_t, double>> ranked;
+    if(docs_.empty()) {
+        return ranked;
+    }
+    double total_length = 0;
+    for(const auto& d : docs_) total_length += d.length;
+    const double avg_length = std::max(1.0, total_length / docs_.size());
+    const double n = static_cast<double>(docs_.size());
+
+    auto terms = bm25_terms(query);
+    std::sort(terms.begin(), terms.end());
+    terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+
+    std::vector<double> scores(docs_.size(), 0.0);
+    for(const auto& term : terms) {
+        auto it = postings_.find(term);
+        if(it == postings_.end()) continue;
+        const double df = static_cast<double>(it->second.size());
+        const double idf = std::log(1.0 + (n - df + 0.5) / (df + 0.5));
+        for(const auto& p : it->second) {
+            const double tf = p.tf;
+            const double norm = kK1 * (1.0 - kB + kB * docs_[p.doc].length / avg_length);
+            scores[p.doc] += idf * tf * (kK1 + 1.0) / (tf + norm);
+        }
+    }
+    for(std::uint32_t i = 0; i < scores.size(); i++) {
+        if(scores[i] > 0) ranked.emplace_back(i, scores[i]);
+    }
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [](const auto& a, const auto& b) { return a.second > b.second; });
+    return ranked;
+}
+
+bool Bm25Index::save(const fs::path& file) const {
+    std::error_code ec;
+    if(file.has_parent_path()) {
+        fs::create_directories(file.parent_path(), ec);
+    }
+    std::ofstream os(file, std::ios::binary | std::ios::trunc);
+    if(!os) {
+        return false;
+    }
+    os.write(kMagic, sizeof(kMagic));
+    put_u32(os, kTokenizerVersion);
+    put_u32(os, static_cast<std::uint32_t>(encoding_));
+    put_u32(os, static_cast<std::uint32_t>(docs_.size()));
+    for(const auto& d : docs_) {
+        put_str(os, d.path);
+        put_u64(os, d.size);
+        put_u64(os, static_cast<std::uint64_t>(d.mtime));
+        put_u32(os, d.length);
+    }
+    put_u32(os, static_cast<std::uint32_t>(postings_.size()));
+    for(const auto& [term, list] : postings_) {
+        put_str(os, term);
+        put_u32(os, static_cast<std::uint32_t>(list.size()));
+        for(const auto& p : list) {
+            put_u32(os, p.doc);
+            put_u32(os, p.tf);
+        }
+    }
+    return static_cast<bool>(os);
+}
+
+bool Bm25Index::load(const fs::path& file, EncodingPolicy encoding) {
+    docs_.clear();
+    postings_.clear();
+    std::ifstream is(file, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    if(!is || !is.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), kMagic)) {
+        return false;
+    }
+    auto fail = [&]() {
+        docs_.clear();
+        postings_.clear();
+        return false;
+    };
+    // Postings depend on the tokenizer and on how contents were decoded
+    std::uint32_t tokenizer = 0, stored_encoding = 0;
+    if(!get_u32(is, tokenizer) || !get_u32(is, stored_encoding) || tokenizer != kTokenizerVersion ||
+       stored_encoding != static_cast<std::uint32_t>(encoding)) {
+        return fail();
+    }
+    encoding_ = encoding;
+    // Counts are checked against the bytes left before anything is allocated,
+    // so a corrupt cache can't request huge vectors
+    std::error_code ec;
+    const std::uint64_t file_size = fs::file_size(file, ec);
+    if(ec) return fail();
+    auto fits = [&](std::uint64_t count, std::uint64_t record_size) {
+        const auto pos = is.tellg();
+        return pos >= 0 && count <= (file_size - static_cast<std::uint64_t>(pos)) / record_size;
+    };
+    std::uint32_t doc_count = 0;
+    if(!get_u32(is, doc_count) || !fits(doc_count, 24)) return fail();   // path length, size, mtime, length
+    docs_.resize(doc_count);
+    for(auto& d : docs_) {
+        std::uint64_t mtime = 0;
+        if(!get_str(is, d.path) || !get_u64(is, d.size) || !get_u64(is, mtime) || !get_u32(is, d.length)) {
+            return fail();
+        }
+        d.mtime = static_cast<std::int64_t>(mtime);
+    }
+    std::uint32_t term_count = 0;
+    if(!get_u32(is, term_count) || !fits(term_count, 8)) return fail();   // term length, posting count
+    postings_.reserve(term_count);
+    std::string term;
+    for(std::uint32_t i = 0; i < term_count; i++) {
+        std::uint32_t n = 0;
+        if(!get_str(is, term) || !get_u32(is, n) || !fits(n, 8)) return fail();
+        std::vector<Bm25Posting> list(n);
+        for(auto& p : list) {
+            if(!get_u32(is, p.doc) || !get_u32(is, p.tf) || p.doc >= doc_count) return fail();
+        }
+        postings_.emplace(term, std::move(list));
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "encoding.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A file to index: the path shown in the output and where to read it.
+ */
+struct Bm25Source {
+    std::string path;
+    std::filesystem::path file;
+};
+
+struct Bm25Doc {
+    std::string path;
+    std::uint64_t size{0};
+    std::int64_t mtime{0};
+    std::uint32_t length{0};   // number of indexed terms
+};
+
+struct Bm25Posting {
+    std::uint32_t doc;
+    std::uint32_t tf;
+};
+
+/**
+ * @brief Split text into lower-cased search terms: whole identifiers/words
+ *        plus their snake_case / camelCase parts ("FooClient" -> fooclient, foo, client).
+ */
+std::vector<std::string> bm25_terms(std::string_view text);
+
+/**
+ * @brief Inverted index over file contents and paths, ranked with BM25.
+ */
+class Bm25Index {
+public:
+    /**
+     * @brief Index the given files. Files whose size and modification time
+     *        match an entry of `previous` keep their postings without being read;
+     *        the rest are read and tokenized on `threads` worker threads, each
+     *        with its own postings, merged at the end. Contents are converted
+     *        to UTF-8 with `encoding` first, like the files that are emitted.
+     */
+    void build(const std::vector<Bm25Source>& sources, const Bm25Index* previous, unsigned threads,
+               EncodingPolicy encoding = EncodingPolicy::Transcode);
+
+    /**
+     * @brief Have the next build() keep the (UTF-8) contents of the files it
+     *        reads that contain a term of `query`, i.e. the ones search() can
+     *        return, so they don't have to be read again.
+     */
+    void retain_contents(std::string_view query);
+
+    /// Move out the contents kept for a document, if it was read and retained
+    std::optional<std::string> take_content(std::uint32_t doc);
+
+    /**
+     * @brief Rank documents for a free-text query.
+     * @return (document index, score) pairs with score > 0, best first
+     */
+    std::vector<std::pair<std::uint32_t, double>> search(std::string_view query) const;
+
+    const std::vector<Bm25Doc>& docs() const { return docs_; }
+    size_t reused_docs() const { return reused_; }
+
+    /// Write the index with the tokenizer version and encoding policy it was built with
+    bool save(const std::filesystem::path& file) const;
+    /// @return false if the file isn't a cache, is corrupt, or was written by another
+    ///         tokenizer version or with another encoding policy
+    bool load(const std::filesystem::path& file, EncodingPolicy encoding = EncodingPolicy::Transcode);
+
+private:
+    std::vector<Bm25Doc> docs_;
+    std::unordered_map<std::string, std::vector<Bm25Posting>> postings_;
+    size_t reused_{0};
+    EncodingPolicy encoding_{EncodingPolicy::Transcode};
+    std::vector<std::string> retain_terms_;                // sorted
+    std::vector<std::optional<std::string>> contents_;     // per document, see retain_contents()
+};
@@ -1,48 +1,19 @@
 #include "comment_scrub.hpp"
-#include <regex>
-#include <sstream>
+#include "transform_pipeline.hpp"
 #include <string>
-#include <vector>
-#include <iostream>
-#include <istream>
-#include <fstream>
-#include <algorithm>
 
 /**
- * A simple approach:
- * 1) Remove block comments: /* ... * /, <!-- ... --> (non-greedy)
- * 2) Remove single-line: //..., #..., --..., ;..., etc.
+ * Runs the comment-removal stage of the transform pipeline on its own:
+ * 1) Remove block comments: /* ... * /, <!-- ... --> and //... to end of line
+ * 2) Drop lines starting with #, --, ; or % (after leading whitespace)
  *
  * This is not language-perfect but helps reduce tokens in code-like files.
  */
 std::string remove_comments(const std::string& code) {
-    // Remove multi-line comments:
-    //  - C-style /* ... */
-    //  - HTML <!-- ... -->
-    // Use a single big regex that tries both.
-    std::string result = std::regex_replace(
-        code,
-        std::regex(R"((?s)(/\*.*?\*/)|(<!--.*?-->)|(//[^\n]*))", 
-                   std::regex::ECMAScript),
-        ""
-    );
-
-    // Next, remove single-line patterns that appear at the start or mid-line:
-    //   ^#.*$, ^--.*$, ^;.*$, etc.
-    //   We'll do this line by line to keep newlines intact (some approximate approach).
-    std::stringstream in(result);
-    std::stringstream out;
-    std::string line;
-    static const std::regex singleLinePat(R"(^\s*(#|--|;|%)+(.*))");
-
-    while(std::getline(in, line)) {
-        // check if line matches
-        if(std::regex_match(line, singleLinePat)) {
-            // remove line entirely
-            continue;
-        }
-        out << line << "\n";
-    }
-
-    return out.str();
+    std::string out;
+    out.reserve(code.size());
+    TokenCounter unused;
+    TransformPipeline<true, false, EscapeMode::Raw, false> pipeline(out, unused);
+    pipeline.content(code);
+    return out;
 }
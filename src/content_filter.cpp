@@ -0,0 +1,344 @@
+#include "content_filter.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define G2P_HAVE_SSE2 1
+#endif
+
+namespace {
+
+bool is_regex_meta(char c) {
+    return std::strchr("\\^$.|?*+()[]{}", c) != nullptr && c != '\0';
+}
+
+bool is_alnum(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+bool is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/// Length of the escape sequence starting at re[i] ('\\'): \xHH, \uHHHH, \u{H...}, \cX, \12
+size_t escape_length(std::string_view re, size_t i) {
+    if(i + 1 >= re.size()) {
+        return re.size() - i;
+    }
+    size_t end = i + 2;
+    auto hex_digits = [&](size_t max) {
+        for(size_t k = 0; k < max && end < re.size() && is_hex(re[end]); k++) end++;
+    };
+    switch(re[i + 1]) {
+        case 'x':
+            hex_digits(2);
+            break;
+        case 'u':
+            if(end < re.size() && re[end] == '{') {
+                auto close = re.find('}', end);
+                end = (close == std::string_view::npos) ? re.size() : close + 1;
+            } else {
+                hex_digits(4);
+            }
+            break;
+        case 'c':
+            if(end < re.size() && std::isalpha(static_cast<unsigned char>(re[end]))) end++;
+            break;
+        default:
+            if(re[i + 1] >= '0' && re[i + 1] <= '9') {
+                // Backreferences and octal escapes
+                while(end < re.size() && re[end] >= '0' && re[end] <= '9') end++;
+            }
+            break;
+    }
+    return end - i;
+}
+
+/// Index just past the group or class starting at re[i] ('(' or '[')
+size_t skip_bracketed(std::string_view re, size_t i) {
+    if(re[i] == '[') {
+        i++;
+        if(i < re.size() && re[i] == '^') i++;
+        if(i < re.size() && re[i] == ']') i++;
+        while(i < re.size() && re[i] != ']') {
+            i += (re[i] == '\\') ? escape_length(re, i) : 1;
+        }
+        return std::min(i + 1, re.size());
+    }
+    int depth = 0;
+    while(i < re.size()) {
+        char c = re[i];
+        if(c == '\\') {
+            i += escape_length(re, i);
+            continue;
+        }
+        if(c == '[') {
+            i = skip_bracketed(re, i);
+            continue;
+        }
+        if(c == '(') depth++;
+        if(c == ')' && --depth == 0) return i + 1;
+        i++;
+    }
+    return re.size();
+}
+
+} // namespace
+
+MultiLiteralSearcher::MultiLiteralSearcher(std::vector<std::string> literals)
+    : literals_(std::move(literals)) {
+    literals_.erase(std::remove_if(literals_.begin(), literals_.end(),
+                                   [](const std::string& l) { return l.empty(); }),
+                    literals_.end());
+    for(const auto& l : literals_) {
+        first_byte_[static_cast<unsigned char>(l[0])] = true;
+    }
+}
+
+bool MultiLiteralSearcher::matches_at(std::string_view text, size_t pos) const {
+    for(const auto& l : literals_) {
+        if(l.size() <= text.size() - pos && std::memcmp(text.data() + pos, l.data(), l.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t MultiLiteralSearcher::find(std::string_view text, size_t from) const {
+    if(literals_.empty() || from >= text.size()) {
+        return std::string_view::npos;
+    }
+    if(literals_.size() == 1) {
+        return text.find(literals_[0], from);
+    }
+
+    size_t i = from;
+#ifdef G2P_HAVE_SSE2
+    const char* data = text.data();
+    for(; i + 17 <= text.size(); i += 16) {
+        const __m128i block0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        const __m128i block1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        __m128i hits = _mm_setzero_si128();
+        for(const auto& l : literals_) {
+            // Fingerprint = first two bytes (or one for single-byte literals)
+            __m128i m = _mm_cmpeq_epi8(block0, _mm_set1_epi8(l[0]));
+            if(l.size() > 1) {
+                m = _mm_and_si128(m, _mm_cmpeq_epi8(block1, _mm_set1_epi8(l[1])));
+            }
+            hits = _mm_or_si128(hits, m);
+        }
+        unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        while(bits != 0) {
+            const size_t pos = i + static_cast<size_t>(__builtin_ctz(bits));
+            if(matches_at(text, pos)) {
+                return pos;
+            }
+            bits &= bits - 1;
+        }
+    }
+#endif
+    for(; i < text.size(); i++) {
+        if(first_byte_[static_cast<unsigned char>(text[i])] && matches_at(text, i)) {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+std::string required_literal(std::string_view re) {
+    // A top-level alternation has no single required literal
+    for(size_t i = 0; i < re.size();) {
+        if(re[i] == '\\') {
+            i += escape_length(re, i);
+        } else if(re[i] == '(' || re[i] == '[') {
+            i = skip_bracketed(re, i);
+        } else if(re[i] == '|') {
+            return "";
+        } else {
+            i++;
+        }
+    }
+
+    std::string best, run;
+    bool last_literal = false;   // the previous atom was appended to run
+    auto flush = [&]() {
+        if(run.size() > best.size()) best = run;
+        run.clear();
+        last_literal = false;
+    };
+    for(size_t i = 0; i < re.size();) {
+        char c = re[i];
+        if(c == '\\') {
+            if(i + 1 < re.size() && !is_alnum(re[i + 1])) {
+                run.push_back(re[i + 1]);
+                last_literal = true;
+                i += 2;
+            } else {
+                flush();   // \d, \w, \b, \n, \x41, \u0041, ...
+                i += escape_length(re, i);
+            }
+        } else if(c == '(' || c == '[') {
+            flush();
+            i = skip_bracketed(re, i);
+        } else if(c == '*' || c == '?' || c == '{') {
+            // The previous atom is optional (or repeated a variable number of times)
+            if(last_literal) run.pop_back();
+            flush();
+            if(c == '{') {
+                auto close = re.find('}', i);
+                i = (close == std::string_view::npos) ? re.size() : close + 1;
+            } else {
+                i++;
+            }
+        } else if(is_regex_meta(c)) {
+            flush();   // '+' keeps the previous atom but ends the run; . ^ $ ) ] }
+            i++;
+        } else {
+            run.push_back(c);
+            last_literal = true;
+            i++;
+        }
+    }
+    flush();
+    return best;
+}
+
+bool ContentFilter::compile(const GrepOptions& options, std::string& error_msg) {
+    patterns_.clear();
+    hunks_ = options.hunks;
+    context_ = options.context;
+    use_prefilter_ = !options.patterns.empty();
+    std::vector<std::string> literals;
+    for(const auto& p : options.patterns) {
+        Pattern pat;
+        pat.is_literal = std::none_of(p.begin(), p.end(), is_regex_meta);
+        pat.literal = pat.is_literal ? p : required_literal(p);
+        if(!pat.is_literal) {
+            try {
+                pat.re = std::regex(p, std::regex::ECMAScript | std::regex::optimize);
+            } catch(const std::regex_error& e) {
+                error_msg = "Invalid --grep pattern '" + p + "': " + e.what();
+                patterns_.clear();
+                return false;
+            }
+        }
+        // A pattern without a required literal can match any line
+        if(pat.literal.empty()) {
+            use_prefilter_ = false;
+        }
+        literals.push_back(pat.literal);
+        patterns_.push_back(std::move(pat));
+    }
+    prefilter_ = MultiLiteralSearcher(std::move(literals));
+    return true;
+}
+
+bool ContentFilter::line_matches(std::string_view line) const {
+    for(const auto& p : patterns_) {
+        if(!p.literal.empty() && line.find(p.literal) == std::string_view::npos) {
+            continue;
+        }
+        if(p.is_literal || std::regex_search(line.begin(), line.end(), p.re)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <class Fn>
+void ContentFilter::for_each_match(std::string_view text, Fn&& fn) const {
+    size_t line_no = 1;
+    size_t counted = 0;   // newlines before this offset are included in line_no
+    size_t pos = 0;
+    while(pos < text.size()) {
+        size_t begin = pos;
+        if(use_prefilter_) {
+            size_t hit = prefilter_.find(text, pos);
+            if(hit == std::string_view::npos) {
+                return;
+            }
+            begin = (hit == 0) ? 0 : text.rfind('\n', hit - 1) + 1;   // npos + 1 == 0
+            begin = std::max(begin, pos);
+        }
+        size_t end = text.find('\n', begin);
+        if(end == std::string_view::npos) {
+            end = text.size();
+        }
+        if(line_matches(text.substr(begin, end - begin))) {
+            line_no += static_cast<size_t>(std::count(text.begin() + counted, text.begin() + begin, '\n'));
+            counted = begin;
+            if(!fn(line_no, begin, end)) {
+                return;
+            }
+        }
+        pos = end + 1;
+    }
+}
+
+bool ContentFilter::apply(std::string& content) const {
+    if(patterns_.empty()) {
+        return true;
+    }
+    std::string_view text(content);
+    if(!hunks_) {
+        bool found = false;
+        for_each_match(text, [&](size_t, size_t, size_t) {
+            found = true;
+            return false;
+        });
+        return found;
+    }
+
+    struct Hunk {
+        size_t first_line, begin, end;
+    };
+    std::vector<Hunk> hunks;
+    std::vector<size_t> matched;
+    size_t last_line = 0;   // last line of hunks.back()
+    for_each_match(text, [&](size_t line_no, size_t begin, size_t end) {
+        matched.push_back(line_no);
+        size_t first = line_no;
+        for(size_t k = 0; k < context_ && begin > 0; k++, first--) {
+            begin = (begin < 2) ? 0 : text.rfind('\n', begin - 2) + 1;
+        }
+        size_t last = line_no;
+        for(size_t k = 0; k < context_ && end + 1 < text.size(); k++, last++) {
+            end = std::min(text.find('\n', end + 1), text.size());
+        }
+        if(!hunks.empty() && first <= last_line + 1) {
+            hunks.back().end = std::max(hunks.back().end, end);
+        } else {
+            hunks.push_back({first, begin, end});
+        }
+        last_line = std::max(last_line, last);
+        return true;
+    });
+    if(matched.empty()) {
+        return false;
+    }
+
+    std::string out;
+    auto next_match = matched.begin();
+    for(size_t h = 0; h < hunks.size(); h++) {
+        if(h > 0) {
+            out += "--\n";
+        }
+        size_t line_no = hunks[h].first_line;
+        size_t pos = hunks[h].begin;
+        while(pos <= hunks[h].end && pos < text.size()) {
+            size_t eol = std::min(text.find('\n', pos), text.size());
+            bool is_match = next_match != matched.end() && *next_match == line_no;
+            if(is_match) ++next_match;
+            out += std::to_string(line_no);
+            out.push_back(is_match ? ':' : '-');
+            out.append(text.substr(pos, eol - pos));
+            out.push_back('\n');
+            pos = eol + 1;
+            line_no++;
+        }
+    }
+    content = std::move(out);
+    return true;
+}
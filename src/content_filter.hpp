@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Finds the first occurrence of any of a few literals.
+ *
+ * A single literal is searched with memchr-based std::string_view::find. For
+ * several literals, 16-byte blocks are compared against the first two bytes of
+ * every literal with SSE2 (a simplified Teddy prefilter) and candidate
+ * positions are verified with memcmp; other targets use a first-byte table.
+ */
+class MultiLiteralSearcher {
+public:
+    MultiLiteralSearcher() = default;
+    explicit MultiLiteralSearcher(std::vector<std::string> literals);
+
+    /// @return position of the first match at or after `from`, or std::string_view::npos
+    size_t find(std::string_view text, size_t from = 0) const;
+
+private:
+    bool matches_at(std::string_view text, size_t pos) const;
+
+    std::vector<std::string> literals_;
+    bool first_byte_[256]{};
+};
+
+/**
+ * @brief Longest run of characters every match of the ECMAScript regex must
+ *        contain (e.g. "Foo" for "Foo(Client|Server)"), or "" if none is found.
+ */
+std::string required_literal(std::string_view regex);
+
+struct GrepOptions {
+    std::vector<std::string> patterns;   // regular expressions, matched line by line
+    bool hunks{false};                   // keep only matching lines instead of whole files
+    std::size_t context{0};              // with hunks, lines kept around each match
+};
+
+/**
+ * @brief Content filter for --grep: keeps files (or line ranges) matching any pattern.
+ *
+ * Lines are only handed to the regex engine when the literal prefilter finds a
+ * required literal in them, and patterns without regex syntax never reach it.
+ * Files without a candidate are rejected after a single prefilter pass.
+ */
+class ContentFilter {
+public:
+    /**
+     * @brief Compile the patterns.
+     * @return false if a pattern isn't a valid regular expression (see error_msg)
+     */
+    bool compile(const GrepOptions& options, std::string& error_msg);
+
+    bool empty() const { return patterns_.empty(); }
+
+    /**
+     * @brief Check content against the patterns. In hunk mode content is replaced by
+     *        the matching lines and their context, each prefixed by its line number
+     *        ("12:" for matches, "11-" for context) with "--" between hunks.
+     * @return false if no line matches
+     */
+    bool apply(std::string& content) const;
+
+private:
+    struct Pattern {
+        std::string literal;   // required literal, "" if none
+        bool is_literal{false};  // the whole pattern is this literal
+        std::regex re;
+    };
+
+    bool line_matches(std::string_view line) const;
+
+    /// Call fn(line_no, begin, end) for matching lines until it returns false
+    template <class Fn>
+    void for_each_match(std::string_view text, Fn&& fn) const;
+
+    std::vector<Pattern> patterns_;
+    MultiLiteralSearcher prefilter_;
+    bool use_prefilter_{false};
+    bool hunks_{false};
+    std::size_t context_{0};
+};
@@ -0,0 +1,232 @@
+#include "dir_walker.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <vector>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+std::optional<SymlinkPolicy> parse_symlink_policy(const std::string& name) {
+    if(name == "skip") return SymlinkPolicy::Skip;
+    if(name == "files") return SymlinkPolicy::Files;
+    if(name == "follow") return SymlinkPolicy::Follow;
+    return std::nullopt;
+}
+
+namespace {
+
+#if defined(__linux__)
+
+// Record layout returned by getdents64 (the struct is not exposed by all libcs)
+struct LinuxDirent64 {
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+constexpr size_t kDentsBufferSize = 256 * 1024;
+
+unsigned char mode_to_dtype(mode_t mode) {
+    if(S_ISREG(mode)) return DT_REG;
+    if(S_ISDIR(mode)) return DT_DIR;
+    if(S_ISLNK(mode)) return DT_LNK;
+    return DT_UNKNOWN;
+}
+
+/**
+ * Depth-first walk over directory descriptors. One getdents64 buffer is shared
+ * by all levels: a directory is read completely, files are reported while its
+ * entries are decoded, and only the names of subdirectories are kept to be
+ * visited afterwards.
+ */
+class FdWalker {
+public:
+    FdWalker(SymlinkPolicy symlinks,
+             const std::function<bool(std::string_view)>& skip_dir,
+             const std::function<void(const WalkEntry&)>& on_file)
+        : symlinks_(symlinks), skip_dir_(skip_dir), on_file_(on_file), buffer_(kDentsBufferSize) {}
+
+    void walk(int dir_fd) {
+        if(symlinks_ == SymlinkPolicy::Follow) {
+            struct stat st;
+            if(::fstat(dir_fd, &st) != 0) {
+                return;
+            }
+            auto id = std::make_pair(st.st_dev, st.st_ino);
+            if(std::find(ancestors_.begin(), ancestors_.end(), id) != ancestors_.end()) {
+                spdlog::debug("Symlink loop, not descending: {}", path_);
+                return;
+            }
+            ancestors_.push_back(id);
+        }
+
+        std::vector<std::pair<std::string, bool>> subdirs;   // (name, is a followed symlink)
+        while(true) {
+            long n = ::syscall(SYS_getdents64, dir_fd, buffer_.data(), buffer_.size());
+            if(n < 0) {
+                if(errno == EINTR) continue;
+                spdlog::warn("Could not read directory: {} ({})", path_, std::strerror(errno));
+                break;
+            }
+            if(n == 0) {
+                break;
+            }
+            for(long off = 0; off < n;) {
+                const auto* d = reinterpret_cast<const LinuxDirent64*>(buffer_.data() + off);
+                off += d->d_reclen;
+                const char* name = d->d_name;
+                if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                    continue;
+                }
+
+                unsigned char type = d->d_type;
+                bool via_link = false;
+                struct stat st;
+                if(type == DT_UNKNOWN) {
+                    if(::fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+                    type = mode_to_dtype(st.st_mode);
+                }
+                if(type == DT_LNK) {
+                    if(symlinks_ == SymlinkPolicy::Skip || ::fstatat(dir_fd, name, &st, 0) != 0) {
+                        continue;   // skipped or dangling
+                    }
+                    type = mode_to_dtype(st.st_mode);
+                    via_link = true;
+                    if(type == DT_DIR && symlinks_ != SymlinkPolicy::Follow) {
+                        continue;
+                    }
+                }
+
+                if(type == DT_DIR) {
+                    subdirs.emplace_back(name, via_link);
+                } else if(type == DT_REG) {
+                    const size_t len = path_.size();
+                    if(len > 0) path_.push_back('/');
+                    path_.append(name);
+                    WalkEntry entry;
+                    entry.path = path_;
+                    entry.dir_fd = dir_fd;
+                    entry.name = name;
+                    on_file_(entry);
+                    path_.resize(len);
+                }
+            }
+        }
+
+        for(const auto& [name, via_link] : subdirs) {
+            const size_t len = path_.size();
+            if(len > 0) path_.push_back('/');
+            path_.append(name);
+            if(!skip_dir_(path_)) {
+                int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (via_link ? 0 : O_NOFOLLOW);
+                int fd = ::openat(dir_fd, name.c_str(), flags);
+                if(fd < 0) {
+                    spdlog::warn("Could not open directory: {} ({})", path_, std::strerror(errno));
+                } else {
+                    walk(fd);
+                    ::close(fd);
+                }
+            }
+            path_.resize(len);
+        }
+
+        if(symlinks_ == SymlinkPolicy::Follow) {
+            ancestors_.pop_back();
+        }
+    }
+
+private:
+    SymlinkPolicy symlinks_;
+    const std::function<bool(std::string_view)>& skip_dir_;
+    const std::function<void(const WalkEntry&)>& on_file_;
+    std::vector<char> buffer_;
+    std::string path_;
+    std::vector<std::pair<dev_t, ino_t>> ancestors_;
+};
+
+#else
+
+/// True if the symlinked directory `link` points at one of its own ancestors
+bool is_symlink_loop(const fs::path& link) {
+    std::error_code ec;
+    auto target = fs::canonical(link, ec);
+    if(ec) return true;
+    auto parent = fs::canonical(link.parent_path(), ec);
+    if(ec) return true;
+    auto [t, p] = std::mismatch(target.begin(), target.end(), parent.begin(), parent.end());
+    return t == target.end();
+}
+
+#endif
+
+} // namespace
+
+WalkResult walk_directory(const fs::path& root, SymlinkPolicy symlinks,
+                          const std::function<bool(std::string_view)>& skip_dir,
+                          const std::function<void(const WalkEntry&)>& on_file) {
+    WalkResult wr;
+#if defined(__linux__)
+    int fd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd < 0) {
+        wr.ok = false;
+        wr.error_msg = "Could not open directory: " + root.string() + " (" + std::strerror(errno) + ")";
+        return wr;
+    }
+    FdWalker walker(symlinks, skip_dir, on_file);
+    walker.walk(fd);
+    ::close(fd);
+#else
+    auto options = fs::directory_options::skip_permission_denied;
+    if(symlinks == SymlinkPolicy::Follow) {
+        options |= fs::directory_options::follow_directory_symlink;
+    }
+    try {
+        std::string rel;
+        for(auto it = fs::recursive_directory_iterator(root, options); it != fs::recursive_directory_iterator(); ++it) {
+            const auto& entry = *it;
+            bool link = entry.is_symlink();
+            if(link && symlinks == SymlinkPolicy::Skip) {
+                it.disable_recursion_pending();
+                continue;
+            }
+            // Paths from the iterator always start with root, so this is purely lexical
+            rel = entry.path().lexically_relative(root).generic_string();
+            if(entry.is_directory()) {
+                if(skip_dir(rel) || (link && symlinks == SymlinkPolicy::Follow && is_symlink_loop(entry.path()))) {
+                    it.disable_recursion_pending();
+                }
+            } else if(entry.is_regular_file()) {
+                WalkEntry we;
+                we.path = rel;
+                we.file = &entry.path();
+                on_file(we);
+            }
+        }
+    } catch(const std::exception& e) {
+        wr.ok = false;
+        wr.error_msg = e.what();
+    }
+#endif
+    return wr;
+}
+
+bool read_walk_entry(const WalkEntry& entry, const ReadLimits& limits, std::string& out, bool* skipped) {
+#ifndef _WIN32
+    if(entry.dir_fd >= 0) {
+        return read_file_limited_at(entry.dir_fd, entry.name, limits, out, skipped);
+    }
+#endif
+    return read_file_limited(*entry.file, limits, out, skipped);
+}
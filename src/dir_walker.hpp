@@ -0,0 +1,62 @@
+#pragma once
+
+#include "file_reader.hpp"
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+enum class SymlinkPolicy {
+    Skip,    // ignore all symbolic links
+    Files,   // include links to regular files, don't descend into linked directories
+    Follow   // also descend into linked directories; links back to an ancestor are skipped
+};
+
+/**
+ * @brief Parse "skip", "files" or "follow" into a SymlinkPolicy.
+ * @return std::nullopt for anything else
+ */
+std::optional<SymlinkPolicy> parse_symlink_policy(const std::string& name);
+
+/**
+ * @brief A regular file found by walk_directory(). Only valid during the callback.
+ */
+struct WalkEntry {
+    std::string_view path;                     // relative to the root, '/'-separated
+    int dir_fd{-1};                            // parent directory descriptor (fd-relative backend)
+    const char* name{nullptr};                 // file name within dir_fd
+    const std::filesystem::path* file{nullptr};  // full path (portable backend)
+};
+
+struct WalkResult {
+    bool ok{true};
+    std::string error_msg;
+};
+
+/**
+ * @brief Recursively walk a directory tree and call on_file for every regular file.
+ *
+ * On Linux the tree is read with openat() and large getdents64() buffers:
+ * entry types come from d_type (no stat unless the file system doesn't report
+ * it, or for symlinks), relative paths are built incrementally in one buffer,
+ * and files can be opened relative to their parent descriptor with
+ * read_walk_entry(). Elsewhere std::filesystem::recursive_directory_iterator
+ * is used. Unreadable subdirectories are skipped with a warning.
+ *
+ * @param root Directory to walk
+ * @param symlinks How symbolic links are handled
+ * @param skip_dir Called with the relative path of each directory; return true to not descend into it
+ * @param on_file Called for each regular file
+ * @return WalkResult, with ok == false if root could not be read
+ */
+WalkResult walk_directory(const std::filesystem::path& root, SymlinkPolicy symlinks,
+                          const std::function<bool(std::string_view)>& skip_dir,
+                          const std::function<void(const WalkEntry&)>& on_file);
+
+/**
+ * @brief Read a file found by walk_directory() with read_file_limited semantics,
+ *        relative to its parent directory when possible.
+ */
+bool read_walk_entry(const WalkEntry& entry, const ReadLimits& limits, std::string& out,
+                     bool* skipped = nullptr);
@@ -0,0 +1,312 @@
+#include "encoding.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#ifdef USE_SIMDJSON
+#include "simdjson.h"
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define G2P_HAVE_SSE2 1
+#endif
+
+namespace {
+
+constexpr char32_t kReplacement = 0xFFFD;
+
+// Windows-1252 characters for bytes 0x80-0x9F (undefined bytes keep their C1 code point)
+constexpr char16_t kCp1252High[32] = {
+    0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178,
+};
+
+void append_utf8(char32_t cp, std::string& out) {
+    if(cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if(cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if(cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+char32_t cp1252_to_unicode(unsigned char c) {
+    return (c >= 0x80 && c < 0xA0) ? kCp1252High[c - 0x80] : c;
+}
+
+/// Length of the ASCII run starting at data[i]
+std::size_t ascii_run(std::string_view data, std::size_t i) {
+    const std::size_t start = i;
+#ifdef G2P_HAVE_SSE2
+    while(i + 16 <= data.size()) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data.data() + i));
+        const int mask = _mm_movemask_epi8(block);
+        if(mask != 0) {
+            return i - start + static_cast<std::size_t>(__builtin_ctz(static_cast<unsigned>(mask)));
+        }
+        i += 16;
+    }
+#endif
+    while(i < data.size() && static_cast<unsigned char>(data[i]) < 0x80) {
+        i++;
+    }
+    return i - start;
+}
+
+/// Length of the well-formed multi-byte sequence at data[i], or 0 if it is invalid
+std::size_t utf8_sequence_length(std::string_view data, std::size_t i) {
+    auto byte = [&](std::size_t k) -> unsigned {
+        return i + k < data.size() ? static_cast<unsigned char>(data[i + k]) : 0;
+    };
+    auto cont = [](unsigned b) { return b >= 0x80 && b <= 0xBF; };
+    const unsigned c = byte(0);
+    const unsigned c1 = byte(1);
+    if(c >= 0xC2 && c <= 0xDF) {
+        return cont(c1) ? 2 : 0;
+    }
+    if(c >= 0xE0 && c <= 0xEF) {
+        const unsigned lo = (c == 0xE0) ? 0xA0 : 0x80;
+        const unsigned hi = (c == 0xED) ? 0x9F : 0xBF;
+        return (c1 >= lo && c1 <= hi && cont(byte(2))) ? 3 : 0;
+    }
+    if(c >= 0xF0 && c <= 0xF4) {
+        const unsigned lo = (c == 0xF0) ? 0x90 : 0x80;
+        const unsigned hi = (c == 0xF4) ? 0x8F : 0xBF;
+        return (c1 >= lo && c1 <= hi && cont(byte(2)) && cont(byte(3))) ? 4 : 0;
+    }
+    return 0;
+}
+
+/// Length of the longest valid UTF-8 prefix of data
+std::size_t utf8_valid_prefix(std::string_view data) {
+    std::size_t i = 0;
+    while(i < data.size()) {
+        i += ascii_run(data, i);
+        if(i >= data.size()) {
+            break;
+        }
+        const std::size_t len = utf8_sequence_length(data, i);
+        if(len == 0) {
+            return i;
+        }
+        i += len;
+    }
+    return data.size();
+}
+
+/// Whether data is the start of a UTF-8 sequence that was cut short
+bool is_truncated_sequence(std::string_view data) {
+    if(data.empty()) {
+        return false;
+    }
+    const auto lead = static_cast<unsigned char>(data[0]);
+    const std::size_t len = (lead >= 0xC2 && lead <= 0xDF) ? 2 : (lead >= 0xE0 && lead <= 0xEF) ? 3
+                          : (lead >= 0xF0 && lead <= 0xF4) ? 4 : 0;
+    if(data.size() >= len) {
+        return false;
+    }
+    for(std::size_t i = 1; i < data.size(); i++) {
+        if((static_cast<unsigned char>(data[i]) & 0xC0) != 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Copy UTF-8 data, decoding each invalid byte as Windows-1252 or replacing it with U+FFFD
+std::string repair_utf8(std::string_view data, bool as_cp1252) {
+    std::string out;
+    out.reserve(data.size() + data.size() / 8);
+    std::size_t i = 0;
+    while(i < data.size()) {
+        const std::size_t run = ascii_run(data, i);
+        out.append(data.substr(i, run));
+        i += run;
+        if(i >= data.size()) {
+            break;
+        }
+        std::size_t len = utf8_sequence_length(data, i);
+        if(len > 0) {
+            out.append(data.substr(i, len));
+            i += len;
+        } else {
+            append_utf8(as_cp1252 ? cp1252_to_unicode(static_cast<unsigned char>(data[i])) : kReplacement, out);
+            i++;
+        }
+    }
+    return out;
+}
+
+std::string cp1252_to_utf8(std::string_view data) {
+    std::string out;
+    out.reserve(data.size() + data.size() / 4);
+    std::size_t i = 0;
+    while(i < data.size()) {
+        const std::size_t run = ascii_run(data, i);
+        out.append(data.substr(i, run));
+        i += run;
+        if(i < data.size()) {
+            append_utf8(cp1252_to_unicode(static_cast<unsigned char>(data[i])), out);
+            i++;
+        }
+    }
+    return out;
+}
+
+std::string utf16_to_utf8(std::string_view data, bool big_endian) {
+    const auto* p = reinterpret_cast<const unsigned char*>(data.data());
+    const std::size_t units = data.size() / 2;
+    auto unit = [&](std::size_t k) -> char16_t {
+        return big_endian ? static_cast<char16_t>((p[2 * k] << 8) | p[2 * k + 1])
+                          : static_cast<char16_t>(p[2 * k] | (p[2 * k + 1] << 8));
+    };
+
+    std::string out;
+    out.reserve(units + units / 4);
+    std::size_t k = 0;
+    while(k < units) {
+#ifdef G2P_HAVE_SSE2
+        // 8 code units at a time while they are all ASCII
+        while(k + 8 <= units) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 2 * k));
+            if(big_endian) {
+                v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+            }
+            const __m128i high = _mm_and_si128(v, _mm_set1_epi16(static_cast<short>(0xFF80)));
+            if(_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) != 0xFFFF) {
+                break;
+            }
+            char packed[16];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(packed), _mm_packus_epi16(v, v));
+            out.append(packed, 8);
+            k += 8;
+        }
+        if(k >= units) {
+            break;
+        }
+#endif
+        const char16_t u = unit(k++);
+        if(u >= 0xD800 && u <= 0xDBFF && k < units) {
+            const char16_t lo = unit(k);
+            if(lo >= 0xDC00 && lo <= 0xDFFF) {
+                k++;
+                append_utf8(0x10000 + ((static_cast<char32_t>(u) - 0xD800) << 10) + (lo - 0xDC00), out);
+                continue;
+            }
+        }
+        append_utf8((u >= 0xD800 && u <= 0xDFFF) ? kReplacement : u, out);
+    }
+    if(data.size() % 2 != 0) {
+        append_utf8(kReplacement, out);
+    }
+    return out;
+}
+
+} // namespace
+
+std::optional<EncodingPolicy> parse_encoding_policy(const std::string& name) {
+    if(name == "transcode") return EncodingPolicy::Transcode;
+    if(name == "replace") return EncodingPolicy::Replace;
+    if(name == "skip") return EncodingPolicy::Skip;
+    return std::nullopt;
+}
+
+DetectedEncoding detect_encoding(std::string_view data) {
+    DetectedEncoding det;
+    if(data.substr(0, 3) == "\xEF\xBB\xBF") {
+        det.bom_size = 3;
+        return det;
+    }
+    if(data.substr(0, 2) == "\xFF\xFE") {
+        det.encoding = TextEncoding::Utf16LE;
+        det.bom_size = 2;
+        return det;
+    }
+    if(data.substr(0, 2) == "\xFE\xFF") {
+        det.encoding = TextEncoding::Utf16BE;
+        det.bom_size = 2;
+        return det;
+    }
+
+    std::string_view block = data.substr(0, kEncodingDetectBlock);
+
+    // UTF-16 text that is mostly ASCII has a NUL in every other byte
+    const std::size_t pairs = block.size() / 2;
+    if(pairs > 0 && std::memchr(block.data(), 0, block.size()) != nullptr) {
+        std::size_t even_zeros = 0, odd_zeros = 0;
+        for(std::size_t k = 0; k < pairs; k++) {
+            even_zeros += block[2 * k] == '\0';
+            odd_zeros += block[2 * k + 1] == '\0';
+        }
+        if(odd_zeros * 4 >= pairs && even_zeros * 16 <= pairs) {
+            det.encoding = TextEncoding::Utf16LE;
+            return det;
+        }
+        if(even_zeros * 4 >= pairs && odd_zeros * 16 <= pairs) {
+            det.encoding = TextEncoding::Utf16BE;
+            return det;
+        }
+    }
+
+    // The data may be an excerpt or a probe: a sequence cut by either edge
+    // doesn't count as invalid
+    std::size_t lead = 0;
+    while(lead < block.size() && lead < 3 && (static_cast<unsigned char>(block[lead]) & 0xC0) == 0x80) {
+        lead++;
+    }
+    block.remove_prefix(lead);
+    const std::size_t valid = utf8_valid_prefix(block);
+    if(valid < block.size() && !is_truncated_sequence(block.substr(valid))) {
+        det.encoding = TextEncoding::Latin1;
+    }
+    return det;
+}
+
+bool is_valid_utf8(std::string_view data) {
+#ifdef USE_SIMDJSON
+    return simdjson::validate_utf8(data.data(), data.size());
+#else
+    return utf8_valid_prefix(data) == data.size();
+#endif
+}
+
+std::string to_utf8(std::string_view data, TextEncoding encoding, EncodingPolicy policy) {
+    switch(encoding) {
+        case TextEncoding::Utf8:
+            // Mostly UTF-8 with stray legacy bytes
+            return is_valid_utf8(data) ? std::string(data) : repair_utf8(data, policy == EncodingPolicy::Transcode);
+        case TextEncoding::Latin1:
+            return (policy == EncodingPolicy::Transcode) ? cp1252_to_utf8(data) : repair_utf8(data, false);
+        case TextEncoding::Utf16LE:
+        case TextEncoding::Utf16BE:
+            return utf16_to_utf8(data, encoding == TextEncoding::Utf16BE);
+    }
+    return std::string(data);
+}
+
+bool normalize_encoding(std::string& content, EncodingPolicy policy) {
+    const DetectedEncoding det = detect_encoding(content);
+    const std::string_view body = std::string_view(content).substr(det.bom_size);
+
+    if(det.encoding == TextEncoding::Utf8 && is_valid_utf8(body)) {
+        content.erase(0, det.bom_size);
+        return true;
+    }
+    if(policy == EncodingPolicy::Skip) {
+        return false;
+    }
+    content = to_utf8(body, det.encoding, policy);
+    return true;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+enum class EncodingPolicy {
+    Transcode,  // convert UTF-16 and Latin-1 (Windows-1252) files to UTF-8
+    Replace,    // decode UTF-16, replace other invalid UTF-8 bytes with U+FFFD
+    Skip        // drop files that aren't valid UTF-8
+};
+
+/**
+ * @brief Parse "transcode", "replace" or "skip" into an EncodingPolicy.
+ * @return std::nullopt for anything else
+ */
+std::optional<EncodingPolicy> parse_encoding_policy(const std::string& name);
+
+enum class TextEncoding {
+    Utf8,
+    Utf16LE,
+    Utf16BE,
+    Latin1   // any 8-bit text that isn't UTF-8, decoded as Windows-1252
+};
+
+/// Bytes examined by detect_encoding()
+inline constexpr std::size_t kEncodingDetectBlock = 4096;
+
+struct DetectedEncoding {
+    TextEncoding encoding{TextEncoding::Utf8};
+    std::size_t bom_size{0};   // bytes of byte order mark at the start of the data
+};
+
+/**
+ * @brief Guess the encoding of a file from its first block (4 KiB): a byte order
+ *        mark if present, otherwise UTF-16 if NUL bytes are concentrated on odd
+ *        or even offsets, otherwise UTF-8 if the block is valid UTF-8, else Latin-1.
+ *        A UTF-8 sequence cut by the start or end of the data is tolerated.
+ */
+DetectedEncoding detect_encoding(std::string_view data);
+
+/**
+ * @brief Check that data is well-formed UTF-8 (no overlongs, surrogates or code
+ *        points above U+10FFFF). Uses simdjson's validator when built with
+ *        USE_SIMDJSON, otherwise skips ASCII 16 bytes at a time with SSE2.
+ */
+bool is_valid_utf8(std::string_view data);
+
+/**
+ * @brief Convert text whose encoding is already known (without its byte order
+ *        mark) to UTF-8, as normalize_encoding() does after detection. Used for
+ *        excerpts of a file that was detected as a whole.
+ * @param policy Transcode or Replace; the caller handles Skip
+ */
+std::string to_utf8(std::string_view data, TextEncoding encoding, EncodingPolicy policy);
+
+/**
+ * @brief Make file content valid UTF-8 according to the policy.
+ *
+ * Valid UTF-8 without a byte order mark is left untouched after a single
+ * validation pass. A UTF-8 BOM is removed. Otherwise the content is transcoded
+ * (ASCII runs are copied 16 bytes at a time) or, with Skip, rejected.
+ *
+ * @param content File content, replaced by its UTF-8 version
+ * @param policy What to do with content that isn't UTF-8
+ * @return false if the file should be skipped
+ */
+bool normalize_encoding(std::string& content, EncodingPolicy policy);
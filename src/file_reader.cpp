@@ -0,0 +1,473 @@
+#include "file_reader.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr std::uint64_t kUnlimited = std::numeric_limits<std::uint64_t>::max();
+constexpr std::uint64_t kBlockSize = 64 * 1024;
+
+/// Positioned reads through an ifstream (portable)
+struct StreamSource {
+    std::ifstream& ifs;
+
+    bool read_at(std::uint64_t offset, std::uint64_t len, char* dst) {
+        ifs.clear();
+        ifs.seekg(static_cast<std::streamoff>(offset));
+        ifs.read(dst, static_cast<std::streamsize>(len));
+        return static_cast<std::uint64_t>(ifs.gcount()) == len;
+    }
+};
+
+/// Positioned reads from memory
+struct StringSource {
+    std::string_view data;
+
+    bool read_at(std::uint64_t offset, std::uint64_t len, char* dst) {
+        if(offset > data.size() || len > data.size() - offset) {
+            return false;
+        }
+        std::memcpy(dst, data.data() + offset, len);
+        return true;
+    }
+};
+
+#ifndef _WIN32
+/// Positioned reads with pread() on an open descriptor
+struct FdSource {
+    int fd;
+
+    bool read_at(std::uint64_t offset, std::uint64_t len, char* dst) {
+        while(len > 0) {
+            ssize_t n = ::pread(fd, dst, len, static_cast<off_t>(offset));
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n <= 0) {
+                return false;
+            }
+            dst += n;
+            offset += static_cast<std::uint64_t>(n);
+            len -= static_cast<std::uint64_t>(n);
+        }
+        return true;
+    }
+};
+#endif
+
+template <class Source>
+bool append_range(Source& src, std::uint64_t begin, std::uint64_t end, std::string& out) {
+    auto old = out.size();
+    out.resize(old + (end - begin));
+    return src.read_at(begin, end - begin, out.data() + old);
+}
+
+void append_marker(std::uint64_t omitted, std::string& out) {
+    if(!out.empty() && out.back() != '\n') {
+        out.push_back('\n');
+    }
+    out += "[... " + std::to_string(omitted) + " bytes omitted ...]\n";
+}
+
+/// Where code units and line breaks are in the raw bytes of a file
+struct Layout {
+    std::uint64_t unit{1};   // bytes per code unit: 2 for UTF-16
+    bool big_endian{false};
+    bool utf8{true};         // single-byte text is UTF-8 unless detected as Latin-1
+
+    bool newline_at(const char* p) const {
+        if(unit == 1) return *p == '\n';
+        return big_endian ? (p[0] == '\0' && p[1] == '\n') : (p[0] == '\n' && p[1] == '\0');
+    }
+
+    std::uint64_t align_down(std::uint64_t v) const { return v - v % unit; }
+    std::uint64_t align_up(std::uint64_t v) const { return align_down(v + unit - 1); }
+
+    /// Offset just past the first (from_end: last) line break in s, or npos;
+    /// s starts on a code unit boundary
+    size_t line_end(std::string_view s, bool from_end) const {
+        if(unit == 1) {
+            size_t nl = from_end ? s.rfind('\n') : s.find('\n');
+            return nl == std::string_view::npos ? nl : nl + 1;
+        }
+        const size_t units = s.size() / 2;
+        for(size_t k = 0; k < units; k++) {
+            const size_t i = 2 * (from_end ? units - 1 - k : k);
+            if(newline_at(s.data() + i)) return i + 2;
+        }
+        return std::string_view::npos;
+    }
+
+    char16_t code_unit(const char* p) const {
+        const auto* b = reinterpret_cast<const unsigned char*>(p);
+        return static_cast<char16_t>(big_endian ? (b[0] << 8) | b[1] : b[0] | (b[1] << 8));
+    }
+
+    /// Bytes to drop from the end of a head cut without a line break, so
+    /// neither a UTF-8 sequence nor a UTF-16 surrogate pair is split
+    size_t head_overhang(std::string_view head) const {
+        if(unit == 2 && head.size() >= 2) {
+            const char16_t u = code_unit(head.data() + head.size() - 2);
+            return (u >= 0xD800 && u <= 0xDBFF) ? 2 : 0;
+        }
+        if(unit == 1 && utf8) {
+            // Back off over continuation bytes to the lead byte of the last sequence
+            size_t i = head.size();
+            while(i > 0 && head.size() - i < 4) {
+                const auto b = static_cast<unsigned char>(head[--i]);
+                if((b & 0xC0) == 0x80) {
+                    continue;
+                }
+                const size_t len = b >= 0xF0 ? 4 : b >= 0xE0 ? 3 : b >= 0xC0 ? 2 : 1;
+                return head.size() - i < len ? head.size() - i : 0;
+            }
+        }
+        return 0;
+    }
+
+    /// Bytes to skip at the start of a tail cut without a line break
+    size_t tail_overhang(std::string_view block) const {
+        if(unit == 2 && block.size() >= 2) {
+            const char16_t u = code_unit(block.data());
+            return (u >= 0xDC00 && u <= 0xDFFF) ? 2 : 0;
+        }
+        if(unit == 1 && utf8) {
+            // Continuation bytes belong to a character that starts before the cut
+            size_t i = 0;
+            while(i < block.size() && i < 3 && (static_cast<unsigned char>(block[i]) & 0xC0) == 0x80) {
+                i++;
+            }
+            return i;
+        }
+        return 0;
+    }
+};
+
+/**
+ * Read forward from the start of the file until max_lines line breaks have
+ * been seen or max_bytes have been read. A byte-limited cut is moved back to
+ * the last line break inside the range, if any, and always falls on a code
+ * unit boundary.
+ */
+template <class Source>
+bool read_head(Source& src, std::uint64_t size, const Layout& layout,
+               std::uint64_t max_bytes, std::uint64_t max_lines, std::string& head)
+{
+    head.clear();
+    if(max_bytes == 0 || max_lines == 0) {
+        return true;
+    }
+    std::uint64_t limit = std::min(size, max_bytes);
+    if(limit < size) {
+        limit = layout.align_down(limit);
+    }
+    std::uint64_t lines = 0;
+    while(head.size() < limit) {
+        const std::uint64_t old = head.size();
+        const std::uint64_t chunk = std::min(kBlockSize, limit - old);
+        head.resize(old + chunk);
+        if(!src.read_at(old, chunk, head.data() + old)) {
+            return false;
+        }
+        if(max_lines == kUnlimited) {
+            continue;
+        }
+        if(layout.unit == 1) {
+            const char* p = head.data() + old;
+            const char* end = p + chunk;
+            while((p = static_cast<const char*>(std::memchr(p, '\n', end - p))) != nullptr) {
+                ++p;
+                if(++lines == max_lines) {
+                    head.resize(p - head.data());
+                    return true;
+                }
+            }
+        } else {
+            // Blocks are a whole number of code units, so none straddles two reads
+            for(std::uint64_t i = old; i + 2 <= old + chunk; i += 2) {
+                if(layout.newline_at(head.data() + i) && ++lines == max_lines) {
+                    head.resize(i + 2);
+                    return true;
+                }
+            }
+        }
+    }
+    if(head.size() < size) {
+        size_t end = layout.line_end(head, true);
+        head.resize(end != std::string::npos ? end : head.size() - layout.head_overhang(head));
+    }
+    return true;
+}
+
+/**
+ * Find where the kept tail starts by scanning blocks backwards from the end of
+ * the file. The line break terminating the last line does not start a new
+ * line. A byte-limited start is moved forward past the first line break inside
+ * the range, if any, and always falls on a code unit boundary.
+ */
+template <class Source>
+bool find_tail_start(Source& src, std::uint64_t size, const Layout& layout,
+                     std::uint64_t max_bytes, std::uint64_t max_lines, std::uint64_t& start)
+{
+    start = size;
+    // An odd trailing byte of a UTF-16 file isn't part of any code unit
+    const std::uint64_t top = layout.align_down(size);
+    if(max_bytes == 0 || max_lines == 0 || top == 0) {
+        return true;
+    }
+    const std::uint64_t floor = (max_bytes >= size) ? 0 : layout.align_up(size - max_bytes);
+    const std::uint64_t last = top - layout.unit;
+    std::string block;
+
+    if(max_lines == kUnlimited) {
+        start = floor;
+        if(floor == 0) {
+            return true;
+        }
+        block.resize(std::min(kBlockSize, size - floor));
+        if(!src.read_at(floor, block.size(), block.data())) {
+            return false;
+        }
+        size_t end = layout.line_end(block, false);
+        if(end != std::string::npos && floor + end - layout.unit != last) {
+            start = floor + end;
+        } else {
+            start = floor + layout.tail_overhang(block);
+        }
+        return true;
+    }
+
+    std::uint64_t pos = top;
+    std::uint64_t lines = 0;
+    std::uint64_t lowest_nl = kUnlimited;
+    while(pos > floor) {
+        const std::uint64_t chunk = std::min(kBlockSize, pos - floor);
+        pos -= chunk;
+        block.resize(chunk);
+        if(!src.read_at(pos, chunk, block.data())) {
+            return false;
+        }
+        for(std::uint64_t i = chunk; i >= layout.unit;) {
+            i -= layout.unit;
+            if(!layout.newline_at(block.data() + i) || pos + i == last) {
+                continue;
+            }
+            lowest_nl = pos + i;
+            if(++lines == max_lines) {
+                start = lowest_nl + layout.unit;
+                return true;
+            }
+        }
+    }
+    start = floor;
+    if(floor > 0) {
+        // block holds the range starting at floor
+        start = (lowest_nl != kUnlimited) ? lowest_nl + layout.unit : floor + layout.tail_overhang(block);
+    }
+    return true;
+}
+
+/// The kept parts of a file, as raw bytes
+struct Excerpt {
+    std::string head;
+    std::uint64_t omitted{0};      // bytes left out between head and tail
+    std::uint64_t tail_begin{0};   // file offset of tail
+    std::string tail;
+};
+
+/**
+ * Read the kept ranges of a file of the given size through any source with
+ * positioned reads.
+ */
+template <class Source>
+bool read_excerpt(Source& src, std::uint64_t size, const ReadLimits& limits, const Layout& layout, Excerpt& ex) {
+    ex.tail_begin = size;
+    const std::uint64_t bytes = limits.max_bytes ? limits.max_bytes : kUnlimited;
+    const std::uint64_t lines = limits.max_lines ? limits.max_lines : kUnlimited;
+    auto half_up = [](std::uint64_t v) { return v == kUnlimited ? v : (v + 1) / 2; };
+    auto half_down = [](std::uint64_t v) { return v == kUnlimited ? v : v / 2; };
+
+    switch(limits.policy) {
+        case TruncatePolicy::Head: {
+            if(!read_head(src, size, layout, bytes, lines, ex.head)) {
+                return false;
+            }
+            ex.omitted = size - ex.head.size();
+            return true;
+        }
+        case TruncatePolicy::Tail: {
+            std::uint64_t start = 0;
+            if(!find_tail_start(src, size, layout, bytes, lines, start)) {
+                return false;
+            }
+            ex.omitted = start;
+            ex.tail_begin = start;
+            return append_range(src, start, size, ex.tail);
+        }
+        case TruncatePolicy::HeadTail: {
+            if(!read_head(src, size, layout, half_up(bytes), half_up(lines), ex.head)) {
+                return false;
+            }
+            const std::uint64_t head_end = ex.head.size();
+            if(head_end == size) {
+                return true;
+            }
+            std::uint64_t start = 0;
+            if(!find_tail_start(src, size, layout, half_down(bytes), half_down(lines), start)) {
+                return false;
+            }
+            start = std::max(start, head_end);
+            ex.omitted = start - head_end;
+            ex.tail_begin = start;
+            return append_range(src, start, size, ex.tail);
+        }
+    }
+    return false;
+}
+
+/**
+ * Read a file through any source with positioned reads. With limits.encoding
+ * set, a whole file is converted to UTF-8. A truncated one has its encoding
+ * detected from the first block first: line breaks and cuts are then found on
+ * UTF-16 code units, and the kept ranges of UTF-16 and Latin-1 files are
+ * converted on their own, so only they are read.
+ */
+template <class Source>
+bool read_limited(Source& src, std::uint64_t size, const ReadLimits& limits, std::string& out, bool* skipped) {
+    if(skipped) {
+        *skipped = false;
+    }
+    if(!limits.enabled()) {
+        if(!append_range(src, 0, size, out)) {
+            return false;
+        }
+        if(limits.encoding && !normalize_encoding(out, *limits.encoding)) {
+            out.clear();
+            if(skipped) {
+                *skipped = true;
+            }
+        }
+        return true;
+    }
+
+    Layout layout;
+    TextEncoding encoding = TextEncoding::Utf8;
+    std::uint64_t bom = 0;
+    if(limits.encoding) {
+        // One byte past the detection block, so a sequence cut by its end isn't
+        // mistaken for invalid UTF-8
+        std::string probe(std::min<std::uint64_t>(size, kEncodingDetectBlock + 1), '\0');
+        if(!src.read_at(0, probe.size(), probe.data())) {
+            return false;
+        }
+        const DetectedEncoding det = detect_encoding(probe);
+        encoding = det.encoding;
+        bom = det.bom_size;
+        if(encoding != TextEncoding::Utf8 && *limits.encoding == EncodingPolicy::Skip) {
+            if(skipped) {
+                *skipped = true;
+            }
+            return true;
+        }
+        layout.utf8 = encoding == TextEncoding::Utf8;
+        if(encoding == TextEncoding::Utf16LE || encoding == TextEncoding::Utf16BE) {
+            layout.unit = 2;
+            layout.big_endian = encoding == TextEncoding::Utf16BE;
+        }
+    }
+
+    Excerpt ex;
+    if(!read_excerpt(src, size, limits, layout, ex)) {
+        return false;
+    }
+    if(encoding != TextEncoding::Utf8) {
+        auto convert = [&](std::string& raw, std::uint64_t offset) {
+            std::string_view body(raw);
+            if(offset < bom) {
+                body.remove_prefix(std::min<std::uint64_t>(bom - offset, body.size()));
+            }
+            raw = to_utf8(body, encoding, *limits.encoding);
+        };
+        convert(ex.head, 0);
+        convert(ex.tail, ex.tail_begin);
+    }
+    out = std::move(ex.head);
+    if(ex.omitted > 0) {
+        append_marker(ex.omitted, out);
+    }
+    out += ex.tail;
+    return true;
+}
+
+} // namespace
+
+std::optional<TruncatePolicy> parse_truncate_policy(const std::string& name) {
+    if(name == "head") return TruncatePolicy::Head;
+    if(name == "tail") return TruncatePolicy::Tail;
+    if(name == "head-tail") return TruncatePolicy::HeadTail;
+    return std::nullopt;
+}
+
+void truncate_content(std::string& content, const ReadLimits& limits) {
+    if(!limits.enabled()) {
+        return;
+    }
+    StringSource src{content};
+    Excerpt ex;
+    if(!read_excerpt(src, content.size(), limits, Layout{}, ex)) {
+        return;
+    }
+    std::string out = std::move(ex.head);
+    if(ex.omitted > 0) {
+        append_marker(ex.omitted, out);
+    }
+    out += ex.tail;
+    content = std::move(out);
+}
+
+bool read_file_limited(const fs::path& path, const ReadLimits& limits, std::string& out, bool* skipped) {
+    out.clear();
+    std::ifstream ifs(path, std::ios::binary);
+    if(!ifs) {
+        return false;
+    }
+    std::error_code ec;
+    const std::uint64_t size = fs::file_size(path, ec);
+    if(ec) {
+        return false;
+    }
+    StreamSource src{ifs};
+    return read_limited(src, size, limits, out, skipped);
+}
+
+#ifndef _WIN32
+bool read_file_limited_at(int dir_fd, const char* name, const ReadLimits& limits, std::string& out,
+                          bool* skipped) {
+    out.clear();
+    int fd = ::openat(dir_fd, name, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool ok = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    if(ok) {
+        FdSource src{fd};
+        ok = read_limited(src, static_cast<std::uint64_t>(st.st_size), limits, out, skipped);
+    }
+    ::close(fd);
+    return ok;
+}
+#endif
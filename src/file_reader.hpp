@@ -0,0 +1,80 @@
+#pragma once
+
+#include "encoding.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+enum class TruncatePolicy {
+    Head,     // keep the beginning of the file
+    Tail,     // keep the end of the file
+    HeadTail  // keep both ends, split the budget between them
+};
+
+/**
+ * @brief Per-file size limits. A limit of 0 means "no limit".
+ */
+struct ReadLimits {
+    std::uint64_t max_bytes{0};
+    std::uint64_t max_lines{0};
+    TruncatePolicy policy{TruncatePolicy::Head};
+    // If set, the encoding is detected first: UTF-16 files are cut on code
+    // units and line breaks, and the kept ranges of files that aren't UTF-8
+    // are converted to UTF-8. Cuts in UTF-8 text always fall on whole
+    // characters.
+    std::optional<EncodingPolicy> encoding;
+
+    bool enabled() const { return max_bytes != 0 || max_lines != 0; }
+};
+
+/**
+ * @brief Parse "head", "tail" or "head-tail" into a TruncatePolicy.
+ * @return std::nullopt for anything else
+ */
+std::optional<TruncatePolicy> parse_truncate_policy(const std::string& name);
+
+/**
+ * @brief Read a file, honouring the given limits.
+ *
+ * Without limits the whole file is read. With limits only the kept ranges are
+ * read: the head is read forward from offset 0 and the tail is located by
+ * scanning fixed-size blocks backwards from the end of the file, so the I/O
+ * cost is bounded by the limits rather than the file size. Byte-limited cuts
+ * are moved back to a line boundary when one is available, and otherwise never
+ * split a UTF-8 character. The omitted part is
+ * replaced by a single marker line, e.g. "[... 1048576 bytes omitted ...]".
+ *
+ * With limits.encoding set, the content is converted to UTF-8 as with
+ * normalize_encoding(). When truncating, the first block is checked for UTF-16
+ * or Latin-1 text. The limits still count bytes on disk and only the kept ranges are
+ * read; UTF-16 is cut on 2-byte code units and its own line breaks, and each
+ * kept range is converted to UTF-8 on its own. If the policy rejects the file,
+ * nothing else is read and *skipped is set.
+ *
+ * @param path File to read
+ * @param limits Size limits and truncation policy
+ * @param out Receives the (possibly truncated) content
+ * @param skipped If given, set to whether limits.encoding rejected the file
+ *        (out is then empty)
+ * @return false if the file could not be opened or read
+ */
+bool read_file_limited(const std::filesystem::path& path, const ReadLimits& limits, std::string& out,
+                       bool* skipped = nullptr);
+
+/**
+ * @brief Apply the limits of read_file_limited() to UTF-8 text already in
+ *        memory, e.g. after it was filtered. limits.encoding is ignored.
+ */
+void truncate_content(std::string& content, const ReadLimits& limits);
+
+#ifndef _WIN32
+/**
+ * @brief Same as read_file_limited(), for a file named relative to an open
+ *        directory descriptor (openat + pread), so no path has to be resolved.
+ * @param dir_fd Descriptor of the parent directory
+ * @param name File name within that directory
+ */
+bool read_file_limited_at(int dir_fd, const char* name, const ReadLimits& limits, std::string& out,
+                          bool* skipped = nullptr);
+#endif
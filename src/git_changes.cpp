@@ -0,0 +1,575 @@
+#include "git_changes.hpp"
+#include "git_ignore.hpp"
+#include "repo_scanner.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+uint32_t be32(const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+uint16_t be16(const unsigned char* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+struct StatInfo {
+    bool exists{false};
+    bool is_symlink{false};
+    int64_t mtime_s{0};
+    int64_t mtime_ns{0};
+    uint32_t ino{0};
+    uint64_t size{0};
+};
+
+StatInfo stat_path(const fs::path& path) {
+    StatInfo info;
+#ifndef _WIN32
+    struct stat st;
+    if(::lstat(path.c_str(), &st) != 0) {
+        return info;
+    }
+    info.exists = S_ISREG(st.st_mode) || S_ISLNK(st.st_mode);
+    info.is_symlink = S_ISLNK(st.st_mode);
+    info.mtime_s = st.st_mtime;
+#ifdef __APPLE__
+    info.mtime_ns = st.st_mtimespec.tv_nsec;
+#else
+    info.mtime_ns = st.st_mtim.tv_nsec;
+#endif
+    info.ino = static_cast<uint32_t>(st.st_ino);
+    info.size = static_cast<uint64_t>(st.st_size);
+#else
+    std::error_code ec;
+    auto status = fs::symlink_status(path, ec);
+    if(ec || !(fs::is_regular_file(status) || fs::is_symlink(status))) {
+        return info;
+    }
+    info.exists = true;
+    info.is_symlink = fs::is_symlink(status);
+    auto ftime = fs::last_write_time(path, ec);
+    auto sys = std::chrono::clock_cast<std::chrono::system_clock>(ftime);
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(sys.time_since_epoch()).count();
+    info.mtime_s = ns / 1000000000;
+    info.mtime_ns = ns % 1000000000;
+    info.size = info.is_symlink ? 0 : fs::file_size(path, ec);
+#endif
+    return info;
+}
+
+/// git's offset-style varint (index v4 path prefix lengths)
+bool decode_varint(const unsigned char*& p, const unsigned char* end, uint64_t& val) {
+    if(p >= end) return false;
+    unsigned char c = *p++;
+    val = c & 127;
+    while(c & 128) {
+        if(p >= end) return false;
+        val += 1;
+        c = *p++;
+        val = (val << 7) + (c & 127);
+    }
+    return true;
+}
+
+bool parse_cache_tree(const unsigned char*& p, const unsigned char* end,
+                      const std::string& parent, std::unordered_map<std::string, GitOid>& out)
+{
+    auto nul = static_cast<const unsigned char*>(std::memchr(p, '\0', end - p));
+    if(!nul) return false;
+    std::string name(reinterpret_cast<const char*>(p), nul - p);
+    std::string path = parent.empty() ? name : parent + "/" + name;
+    p = nul + 1;
+
+    auto parse_int = [&](char terminator, long long& v) {
+        auto stop = static_cast<const unsigned char*>(std::memchr(p, terminator, end - p));
+        if(!stop) return false;
+        const char* first = reinterpret_cast<const char*>(p);
+        const char* last = reinterpret_cast<const char*>(stop);
+        auto [ptr, ec] = std::from_chars(first, last, v);
+        if(ec != std::errc() || ptr != last) return false;
+        p = stop + 1;
+        return true;
+    };
+    long long entry_count = 0, subtrees = 0;
+    if(!parse_int(' ', entry_count) || !parse_int('\n', subtrees)) {
+        return false;
+    }
+    if(entry_count >= 0) {
+        if(end - p < 20) return false;
+        GitOid oid;
+        std::copy_n(p, 20, oid.begin());
+        out[path] = oid;
+        p += 20;
+    }
+    for(long long i = 0; i < subtrees; i++) {
+        if(!parse_cache_tree(p, end, path, out)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool is_racy(const GitIndexEntry& e, const GitIndex& index) {
+    if(int64_t(e.mtime_s) != index.mtime_s) {
+        return int64_t(e.mtime_s) > index.mtime_s;
+    }
+    return int64_t(e.mtime_ns) >= index.mtime_ns;
+}
+
+bool stat_matches(const GitIndexEntry& e, const StatInfo& st) {
+    // Index nanoseconds are 0 when git was built without nanosecond support
+    return e.mtime_s == static_cast<uint32_t>(st.mtime_s)
+        && (e.mtime_ns == 0 || e.mtime_ns == static_cast<uint32_t>(st.mtime_ns))
+        && e.size == static_cast<uint32_t>(st.size)
+        && (e.ino == 0 || st.ino == 0 || e.ino == st.ino);
+}
+
+bool content_matches(const fs::path& path, const GitIndexEntry& e, const StatInfo& st) {
+    std::string content;
+    if(st.is_symlink) {
+        std::error_code ec;
+        content = fs::read_symlink(path, ec).generic_string();
+        if(ec) return false;
+    } else {
+        std::ifstream ifs(path, std::ios::binary);
+        if(!ifs) return false;
+        content.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    }
+    return hash_blob(content) == e.oid;
+}
+
+/// Number of directory steps between two directories ("a/b" -> "a/c" is 2)
+size_t dir_distance(std::string_view a, std::string_view b) {
+    auto components = [](std::string_view s) {
+        return s.empty() ? size_t(0) : size_t(std::count(s.begin(), s.end(), '/') + 1);
+    };
+    size_t common = 0;
+    size_t i = 0;
+    while(i < a.size() && i < b.size()) {
+        auto na = a.find('/', i);
+        auto nb = b.find('/', i);
+        if(na == std::string_view::npos) na = a.size();
+        if(nb == std::string_view::npos) nb = b.size();
+        if(na != nb || a.compare(i, na - i, b.substr(i, nb - i)) != 0) break;
+        common++;
+        i = na + 1;
+    }
+    return (components(a) - common) + (components(b) - common);
+}
+
+std::string_view parent_dir(std::string_view path) {
+    auto slash = path.rfind('/');
+    return slash == std::string_view::npos ? std::string_view() : path.substr(0, slash);
+}
+
+/**
+ * Lists untracked files one directory at a time. Index entries are sorted by
+ * path, so the entries under a directory form a contiguous range: names are
+ * looked up in the range of their directory only, and directories without any
+ * tracked entry need no lookups at all. Paths Git ignores (see GitIgnoreRules)
+ * or that match ignore_patterns are skipped; ignored directories and
+ * submodules are not entered.
+ */
+class UntrackedScan {
+public:
+    UntrackedScan(const fs::path& base, const std::vector<GitIndexEntry>& entries,
+                  const IgnoreMatcher& ignore, GitIgnoreRules* git_rules)
+        : base_(base), entries_(entries), ignore_(ignore), git_rules_(git_rules) {}
+
+    void run(std::vector<std::string>& out) {
+        scan("", 0, entries_.size(), out);
+    }
+
+private:
+    using Range = std::pair<size_t, size_t>;
+
+    /// Index entries within [lo, hi) whose path starts with prefix
+    Range prefix_range(const std::string& prefix, size_t lo, size_t hi) const {
+        auto first = entries_.begin() + static_cast<std::ptrdiff_t>(lo);
+        auto last = entries_.begin() + static_cast<std::ptrdiff_t>(hi);
+        auto below = [](const GitIndexEntry& e, const std::string& key) { return e.path < key; };
+        auto begin = std::lower_bound(first, last, prefix, below);
+        std::string upper = prefix;
+        upper.back()++;   // "dir/" -> "dir0": just past every "dir/..." path
+        auto end = std::lower_bound(begin, last, upper, below);
+        return {static_cast<size_t>(begin - entries_.begin()), static_cast<size_t>(end - entries_.begin())};
+    }
+
+    bool is_tracked(const std::string& rel, size_t lo, size_t hi) const {
+        if(lo == hi) {
+            return false;
+        }
+        auto last = entries_.begin() + static_cast<std::ptrdiff_t>(hi);
+        auto it = std::lower_bound(entries_.begin() + static_cast<std::ptrdiff_t>(lo), last, rel,
+                                   [](const GitIndexEntry& e, const std::string& key) { return e.path < key; });
+        return it != last && it->path == rel;
+    }
+
+    bool is_ignored(const std::string& rel, bool is_dir) const {
+        if(git_rules_ && git_rules_->ignored(rel, is_dir)) {
+            return true;
+        }
+        return ignore_.matches(is_dir ? rel + "/" : rel);
+    }
+
+    void scan(const std::string& dir, size_t lo, size_t hi, std::vector<std::string>& out) {
+        if(git_rules_) {
+            git_rules_->enter(dir);
+        }
+        std::error_code ec;
+        fs::directory_iterator it(dir.empty() ? base_ : base_ / dir, fs::directory_options::skip_permission_denied, ec);
+        for(; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            const auto& entry = *it;
+            std::string name = entry.path().filename().string();
+            if(name == ".git") {
+                continue;
+            }
+            std::string rel = dir.empty() ? name : dir + "/" + name;
+            std::error_code type_ec;
+            if(!entry.is_symlink(type_ec) && entry.is_directory(type_ec)) {
+                // A tracked directory path is a submodule
+                if(is_tracked(rel, lo, hi) || is_ignored(rel, true)) {
+                    continue;
+                }
+                auto [sub_lo, sub_hi] = prefix_range(rel + "/", lo, hi);
+                scan(rel, sub_lo, sub_hi, out);
+            } else if(entry.is_regular_file(type_ec) && !is_tracked(rel, lo, hi) && !is_ignored(rel, false)) {
+                out.push_back(std::move(rel));
+            }
+        }
+        if(git_rules_) {
+            git_rules_->leave();
+        }
+    }
+
+    const fs::path& base_;
+    const std::vector<GitIndexEntry>& entries_;
+    const IgnoreMatcher& ignore_;
+    GitIgnoreRules* git_rules_;
+};
+
+/**
+ * Compare a revision's tree against the index. Subtrees whose id equals the
+ * index cache-tree entry for the same directory are identical and skipped.
+ */
+class TreeDiff {
+public:
+    TreeDiff(GitObjectStore& store, const GitIndex& index) : store_(store), index_(index) {
+        for(const auto& e : index.entries) {
+            if(e.stage == 0) by_path_.emplace(e.path, &e);
+        }
+    }
+
+    bool run(const GitOid& tree, std::vector<std::string>& changed) {
+        if(!walk(tree, "", changed)) {
+            return false;
+        }
+        // Entries that exist in the index but not in the revision (added)
+        for(const auto& [path, entry] : by_path_) {
+            if(!seen_.count(path) && !under_clean_dir(path)) {
+                changed.push_back(path);
+            }
+        }
+        return true;
+    }
+
+private:
+    bool walk(const GitOid& tree, const std::string& dir, std::vector<std::string>& changed) {
+        auto cached = index_.cache_tree.find(dir);
+        if(cached != index_.cache_tree.end() && cached->second == tree) {
+            clean_dirs_.insert(dir);
+            return true;
+        }
+        std::string type, data;
+        if(!store_.read(tree, type, data) || type != "tree") {
+            spdlog::warn("Could not read tree {}", oid_to_hex(tree));
+            return false;
+        }
+        // Tree entries: "<mode> <name>\0<20-byte id>"
+        size_t pos = 0;
+        while(pos < data.size()) {
+            auto sp = data.find(' ', pos);
+            auto nul = data.find('\0', sp);
+            if(sp == std::string::npos || nul == std::string::npos || nul + 21 > data.size()) {
+                return false;
+            }
+            std::string_view mode(data.data() + pos, sp - pos);
+            std::string name = data.substr(sp + 1, nul - sp - 1);
+            GitOid oid;
+            std::copy_n(reinterpret_cast<const unsigned char*>(data.data()) + nul + 1, 20, oid.begin());
+            pos = nul + 21;
+
+            std::string path = dir.empty() ? name : dir + "/" + name;
+            if(mode == "40000") {
+                if(!walk(oid, path, changed)) return false;
+                continue;
+            }
+            seen_.insert(path);
+            if(mode == "160000") {
+                continue;   // submodule
+            }
+            auto it = by_path_.find(path);
+            if(it != by_path_.end() && it->second->oid != oid) {
+                changed.push_back(path);
+            }
+        }
+        return true;
+    }
+
+    bool under_clean_dir(std::string_view path) const {
+        if(clean_dirs_.empty()) return false;
+        for(auto dir = parent_dir(path); ; dir = parent_dir(dir)) {
+            if(clean_dirs_.count(std::string(dir))) return true;
+            if(dir.empty()) return false;
+        }
+    }
+
+    GitObjectStore& store_;
+    const GitIndex& index_;
+    std::unordered_map<std::string, const GitIndexEntry*> by_path_;
+    std::unordered_set<std::string> seen_;
+    std::unordered_set<std::string> clean_dirs_;
+};
+
+} // namespace
+
+GitIndex read_git_index(const fs::path& index_file) {
+    GitIndex index;
+    std::ifstream ifs(index_file, std::ios::binary);
+    if(!ifs) {
+        index.ok = false;
+        index.error_msg = "Could not open git index: " + index_file.string();
+        return index;
+    }
+    std::string raw((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    const auto* base = reinterpret_cast<const unsigned char*>(raw.data());
+    const auto* end = base + raw.size();
+
+    auto fail = [&](const std::string& msg) {
+        index.ok = false;
+        index.error_msg = msg + ": " + index_file.string();
+        index.entries.clear();
+        return index;
+    };
+
+    if(raw.size() < 12 + 20 || std::memcmp(base, "DIRC", 4) != 0) {
+        return fail("Not a git index");
+    }
+    const uint32_t version = be32(base + 4);
+    const uint32_t count = be32(base + 8);
+    if(version < 2 || version > 4) {
+        return fail("Unsupported git index version " + std::to_string(version));
+    }
+    end -= 20;   // trailing checksum
+
+    auto st = stat_path(index_file);
+    index.mtime_s = st.mtime_s;
+    index.mtime_ns = st.mtime_ns;
+
+    index.entries.reserve(count);
+    const unsigned char* p = base + 12;
+    std::string prev_path;
+    for(uint32_t i = 0; i < count; i++) {
+        const unsigned char* entry_start = p;
+        if(end - p < 62) {
+            return fail("Truncated git index");
+        }
+        GitIndexEntry e;
+        e.mtime_s = be32(p + 8);
+        e.mtime_ns = be32(p + 12);
+        e.ino = be32(p + 20);
+        e.mode = be32(p + 24);
+        e.size = be32(p + 36);
+        std::copy_n(p + 40, 20, e.oid.begin());
+        const uint16_t flags = be16(p + 60);
+        e.assume_valid = flags & 0x8000;
+        e.stage = (flags >> 12) & 3;
+        p += 62;
+        if((flags & 0x4000) && version >= 3) {
+            if(end - p < 2) return fail("Truncated git index");
+            const uint16_t ext = be16(p);
+            e.skip_worktree = ext & 0x4000;
+            e.intent_to_add = ext & 0x2000;
+            p += 2;
+        }
+
+        if(version == 4) {
+            // Path is stored as "strip N bytes from the previous path, append suffix"
+            uint64_t strip = 0;
+            if(!decode_varint(p, end, strip) || strip > prev_path.size()) {
+                return fail("Corrupt git index path");
+            }
+            auto nul = static_cast<const unsigned char*>(std::memchr(p, '\0', end - p));
+            if(!nul) return fail("Corrupt git index path");
+            e.path = prev_path.substr(0, prev_path.size() - strip);
+            e.path.append(reinterpret_cast<const char*>(p), nul - p);
+            p = nul + 1;
+        } else {
+            auto nul = static_cast<const unsigned char*>(std::memchr(p, '\0', end - p));
+            if(!nul) return fail("Corrupt git index path");
+            e.path.assign(reinterpret_cast<const char*>(p), nul - p);
+            // Entries are NUL-padded to a multiple of 8 bytes
+            const size_t entry_len = (p - entry_start) + e.path.size();
+            p = entry_start + ((entry_len + 8) & ~size_t(7));
+            if(p > end) return fail("Truncated git index");
+        }
+        prev_path = e.path;
+        index.entries.push_back(std::move(e));
+    }
+
+    // Extensions: "<4-byte signature><4-byte size><data>"
+    while(end - p >= 8) {
+        const uint32_t len = be32(p + 4);
+        const unsigned char* data = p + 8;
+        if(static_cast<uint64_t>(end - data) < len) {
+            break;
+        }
+        if(std::memcmp(p, "TREE", 4) == 0) {
+            const unsigned char* q = data;
+            if(!parse_cache_tree(q, data + len, "", index.cache_tree)) {
+                spdlog::debug("Ignoring unreadable cache-tree extension");
+                index.cache_tree.clear();
+            }
+        }
+        p = data + len;
+    }
+    return index;
+}
+
+ChangedFilesResult find_changed_files(const std::string& repo_path,
+                                      const std::string& rev,
+                                      size_t context_files,
+                                      const std::vector<std::string>& ignore_patterns,
+                                      bool git_excludes)
+{
+    ChangedFilesResult result;
+    fs::path base(repo_path);
+    fs::path git_dir = find_git_dir(base);
+    if(git_dir.empty()) {
+        result.ok = false;
+        result.error_msg = "Not a git working tree: " + repo_path;
+        return result;
+    }
+
+    GitIndex index;
+    std::error_code ec;
+    if(fs::exists(git_dir / "index", ec)) {
+        index = read_git_index(git_dir / "index");
+        if(!index.ok) {
+            result.ok = false;
+            result.error_msg = index.error_msg;
+            return result;
+        }
+    }
+
+    std::vector<std::string> changed;
+
+    // 1. Working tree vs index
+    size_t hashed = 0;
+    for(const auto& e : index.entries) {
+        if(e.stage != 0 || e.intent_to_add) {
+            changed.push_back(e.path);   // unmerged or intent-to-add
+            continue;
+        }
+        if(e.skip_worktree || e.assume_valid || (e.mode & 0170000) == 0160000) {
+            continue;
+        }
+        fs::path path = base / e.path;
+        auto st = stat_path(path);
+        if(!st.exists) {
+            continue;   // deleted
+        }
+        if(stat_matches(e, st) && !is_racy(e, index)) {
+            continue;
+        }
+        if(!st.is_symlink && e.size != static_cast<uint32_t>(st.size)) {
+            changed.push_back(e.path);
+            continue;
+        }
+        hashed++;
+        if(!content_matches(path, e, st)) {
+            changed.push_back(e.path);
+        }
+    }
+    spdlog::debug("Compared {} index entries, hashed {}", index.entries.size(), hashed);
+
+    // 2. Index vs revision
+    if(!rev.empty()) {
+        if(!GitObjectStore::available()) {
+            result.ok = false;
+            result.error_msg = "Comparing against a revision requires zlib support (built without HAVE_ZLIB)";
+            return result;
+        }
+        GitObjectStore store(git_dir);
+        auto tree = store.resolve_tree(rev);
+        if(!tree) {
+            result.ok = false;
+            result.error_msg = "Could not resolve revision: " + rev;
+            return result;
+        }
+        TreeDiff diff(store, index);
+        if(!diff.run(*tree, changed)) {
+            result.ok = false;
+            result.error_msg = "Could not read the tree of revision: " + rev;
+            return result;
+        }
+    }
+
+    // 3. Untracked files that are not ignored
+    const IgnoreMatcher ignore(ignore_patterns);
+    GitIgnoreRules git_rules(base, git_dir);
+    UntrackedScan(base, index.entries, ignore, git_excludes ? &git_rules : nullptr).run(changed);
+
+    // Only report files that exist in the working tree
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+    for(auto& path : changed) {
+        if(stat_path(base / path).exists) {
+            result.changed.push_back(std::move(path));
+        }
+    }
+
+    // 4. Context: unchanged tracked files closest to the changed ones
+    if(context_files > 0 && !result.changed.empty()) {
+        std::unordered_set<std::string_view> changed_dirs;
+        std::unordered_set<std::string_view> changed_set(result.changed.begin(), result.changed.end());
+        for(const auto& path : result.changed) {
+            changed_dirs.insert(parent_dir(path));
+        }
+        std::vector<std::pair<size_t, const std::string*>> candidates;
+        for(const auto& e : index.entries) {
+            if(e.stage != 0 || changed_set.count(e.path) || (e.mode & 0170000) == 0160000) {
+                continue;
+            }
+            size_t best = SIZE_MAX;
+            for(auto dir : changed_dirs) {
+                best = std::min(best, dir_distance(parent_dir(e.path), dir));
+            }
+            candidates.emplace_back(best, &e.path);
+        }
+        auto by_rank = [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+        };
+        const size_t n = std::min(context_files, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + n, candidates.end(), by_rank);
+        for(size_t i = 0; i < n; i++) {
+            if(stat_path(base / *candidates[i].second).exists) {
+                result.context.push_back(*candidates[i].second);
+            }
+        }
+    }
+
+    return result;
+}
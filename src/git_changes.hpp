@@ -0,0 +1,72 @@
+#pragma once
+
+#include "git_objects.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct GitIndexEntry {
+    std::string path;
+    uint32_t mtime_s{0};
+    uint32_t mtime_ns{0};
+    uint32_t ino{0};
+    uint32_t mode{0};
+    uint32_t size{0};   // truncated to 32 bits, like git
+    GitOid oid{};
+    int stage{0};
+    bool assume_valid{false};
+    bool skip_worktree{false};
+    bool intent_to_add{false};
+};
+
+struct GitIndex {
+    bool ok{true};
+    std::string error_msg;
+    std::vector<GitIndexEntry> entries;
+    // Directory path ("" for the root) -> tree id, from the cache-tree (TREE) extension.
+    // Only directories whose cached tree is valid are present.
+    std::unordered_map<std::string, GitOid> cache_tree;
+    // Modification time of the index file itself, for racy-git detection
+    int64_t mtime_s{0};
+    int64_t mtime_ns{0};
+};
+
+/**
+ * @brief Parse a .git/index file (versions 2, 3 and 4).
+ */
+GitIndex read_git_index(const std::filesystem::path& index_file);
+
+struct ChangedFilesResult {
+    bool ok{true};
+    std::string error_msg;
+    std::vector<std::string> changed;   // modified, added or untracked (repo-relative, sorted)
+    std::vector<std::string> context;   // unchanged neighbours, closest first
+};
+
+/**
+ * @brief Find files that differ from the index (or from a revision's tree).
+ *
+ * Tracked files are compared by stat data against the index; content is only
+ * hashed when the stat data differs but the size does not, or when the entry
+ * is racily clean (modified in the same second the index was written).
+ * Untracked files are included unless Git ignores them (.gitignore files
+ * and .git/info/exclude, with Git's matching rules) or they match
+ * ignore_patterns. Deleted
+ * files are not reported since there is nothing to emit.
+ *
+ * With a revision, index entries whose blob differs from the revision's tree
+ * are reported as well; subtrees whose id matches the index cache-tree are
+ * skipped without being read.
+ *
+ * @param repo_path Working tree root
+ * @param rev Revision to compare against, or empty to compare against the index only
+ * @param context_files Number of unchanged tracked files to add, ranked by directory proximity
+ * @param ignore_patterns Patterns excluding untracked files (see build_ignore_patterns)
+ * @param git_excludes If false, Git's own ignore files are not consulted
+ */
+ChangedFilesResult find_changed_files(const std::string& repo_path,
+                                      const std::string& rev,
+                                      size_t context_files,
+                                      const std::vector<std::string>& ignore_patterns,
+                                      bool git_excludes = true);
@@ -0,0 +1,190 @@
+#include "git_ignore.hpp"
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * Match the bracket expression starting at g[gi] ('[') against ch. Sets end
+ * to the index just past the closing ']'; returns false if there is none, in
+ * which case the '[' is an ordinary character.
+ */
+bool match_class(std::string_view g, size_t gi, char ch, size_t& end, bool& matched) {
+    size_t i = gi + 1;
+    bool negate = i < g.size() && (g[i] == '!' || g[i] == '^');
+    if(negate) i++;
+    bool hit = false;
+    bool first = true;
+    while(i < g.size() && (first || g[i] != ']')) {
+        first = false;
+        char lo = g[i];
+        if(lo == '\\' && i + 1 < g.size()) lo = g[++i];
+        char hi = lo;
+        if(i + 2 < g.size() && g[i + 1] == '-' && g[i + 2] != ']') {
+            hi = g[i + 2];
+            i += 2;
+        }
+        if(ch >= lo && ch <= hi) hit = true;
+        i++;
+    }
+    if(i >= g.size()) {
+        return false;
+    }
+    end = i + 1;
+    matched = ch != '/' && hit != negate;
+    return true;
+}
+
+bool match_from(std::string_view g, size_t gi, std::string_view t, size_t ti) {
+    while(gi < g.size()) {
+        const char c = g[gi];
+        if(c == '*') {
+            if(gi + 1 < g.size() && g[gi + 1] == '*') {
+                const size_t after = gi + 2;
+                const bool starts_component = gi == 0 || g[gi - 1] == '/';
+                const bool ends_component = after == g.size() || g[after] == '/';
+                if(starts_component && ends_component) {
+                    if(after == g.size()) {
+                        return true;   // trailing "/**": everything inside
+                    }
+                    // "**/": zero or more leading directories
+                    for(size_t k = ti;;) {
+                        if(match_from(g, after + 1, t, k)) return true;
+                        size_t slash = t.find('/', k);
+                        if(slash == std::string_view::npos) return false;
+                        k = slash + 1;
+                    }
+                }
+            }
+            // Any other run of stars matches within one path component
+            size_t next = gi + 1;
+            while(next < g.size() && g[next] == '*') next++;
+            for(size_t k = ti;; k++) {
+                if(match_from(g, next, t, k)) return true;
+                if(k >= t.size() || t[k] == '/') return false;
+            }
+        }
+        if(ti >= t.size()) {
+            return false;
+        }
+        if(c == '?') {
+            if(t[ti] == '/') return false;
+            gi++;
+            ti++;
+            continue;
+        }
+        if(c == '[') {
+            size_t end = 0;
+            bool matched = false;
+            if(match_class(g, gi, t[ti], end, matched)) {
+                if(!matched) return false;
+                gi = end;
+                ti++;
+                continue;
+            }
+        }
+        char lit = c;
+        if(c == '\\' && gi + 1 < g.size()) {
+            lit = g[++gi];
+        }
+        if(lit != t[ti]) {
+            return false;
+        }
+        gi++;
+        ti++;
+    }
+    return ti == t.size();
+}
+
+} // namespace
+
+bool gitignore_glob_match(std::string_view glob, std::string_view path) {
+    return match_from(glob, 0, path, 0);
+}
+
+std::vector<GitIgnorePattern> parse_gitignore(const fs::path& file, const std::string& base) {
+    std::vector<GitIgnorePattern> patterns;
+    std::ifstream ifs(file);
+    if(!ifs) {
+        return patterns;
+    }
+    std::string line;
+    while(std::getline(ifs, line)) {
+        if(!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        // Trailing spaces are dropped unless escaped
+        while(!line.empty() && line.back() == ' ' && !(line.size() > 1 && line[line.size() - 2] == '\\')) {
+            line.pop_back();
+        }
+        if(line.empty() || line[0] == '#') {
+            continue;
+        }
+        GitIgnorePattern pat;
+        pat.base = base;
+        std::string_view p(line);
+        if(p[0] == '!') {
+            pat.negated = true;
+            p.remove_prefix(1);
+        } else if(p.size() > 1 && p[0] == '\\' && (p[1] == '!' || p[1] == '#')) {
+            p.remove_prefix(1);
+        }
+        if(!p.empty() && p.back() == '/') {
+            pat.dir_only = true;
+            p.remove_suffix(1);
+        }
+        pat.anchored = p.find('/') != std::string_view::npos;
+        if(!p.empty() && p[0] == '/') {
+            p.remove_prefix(1);
+        }
+        if(p.empty()) {
+            continue;
+        }
+        pat.glob.assign(p);
+        patterns.push_back(std::move(pat));
+    }
+    return patterns;
+}
+
+GitIgnoreRules::GitIgnoreRules(const fs::path& work_tree, const fs::path& git_dir)
+    : work_tree_(work_tree) {
+    levels_.push_back(parse_gitignore(git_dir / "info" / "exclude", ""));
+}
+
+void GitIgnoreRules::enter(const std::string& dir) {
+    if(dir.empty()) {
+        levels_.push_back(parse_gitignore(work_tree_ / ".gitignore", ""));
+    } else {
+        levels_.push_back(parse_gitignore(work_tree_ / dir / ".gitignore", dir + "/"));
+    }
+}
+
+void GitIgnoreRules::leave() {
+    if(levels_.size() > 1) {
+        levels_.pop_back();
+    }
+}
+
+bool GitIgnoreRules::ignored(std::string_view rel, bool is_dir) const {
+    // Deepest file first, and within a file the last matching line wins
+    for(auto level = levels_.rbegin(); level != levels_.rend(); ++level) {
+        for(auto pat = level->rbegin(); pat != level->rend(); ++pat) {
+            if(pat->dir_only && !is_dir) {
+                continue;
+            }
+            if(rel.compare(0, pat->base.size(), pat->base) != 0) {
+                continue;
+            }
+            std::string_view sub = rel.substr(pat->base.size());
+            if(!pat->anchored) {
+                auto slash = sub.rfind('/');
+                if(slash != std::string_view::npos) sub.remove_prefix(slash + 1);
+            }
+            if(gitignore_glob_match(pat->glob, sub)) {
+                return !pat->negated;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief One line of a .gitignore (or .git/info/exclude) file.
+ */
+struct GitIgnorePattern {
+    std::string glob;      // without the '!', a leading '/' and a trailing '/'
+    std::string base;      // directory of the ignore file, "" for the root, otherwise ending in '/'
+    bool negated{false};   // "!pattern" re-includes what an earlier pattern excluded
+    bool dir_only{false};  // "pattern/" only matches directories
+    bool anchored{false};  // has a '/' before its end: matched against the path below base,
+                           // otherwise against the basename at any depth
+};
+
+/**
+ * @brief Parse an ignore file with Git's syntax: comments, "\#" and "\!"
+ *        escapes, trailing spaces, '!' negation and '/' anchoring.
+ * @param file The ignore file (a missing file yields no patterns)
+ * @param base Directory the file applies to, relative to the work tree ("" or "dir/")
+ */
+std::vector<GitIgnorePattern> parse_gitignore(const std::filesystem::path& file, const std::string& base);
+
+/**
+ * @brief Git wildmatch with pathname semantics: '*' and '?' don't match '/',
+ *        "[...]" classes, '\' escapes, and "**" spanning directories when it is
+ *        a whole path component ("**" + "/x", "x/" + "**", "a/" + "**" + "/b").
+ */
+bool gitignore_glob_match(std::string_view glob, std::string_view path);
+
+/**
+ * @brief Git's exclude rules for a depth-first walk of a work tree.
+ *
+ * .git/info/exclude applies everywhere; each directory's .gitignore is added
+ * when the walk enters it (enter()) and dropped when it leaves (leave()).
+ * Like Git, the last matching pattern of the deepest file wins, and nothing
+ * inside an excluded directory can be re-included, so callers should not
+ * descend into a directory for which ignored() is true.
+ */
+class GitIgnoreRules {
+public:
+    GitIgnoreRules(const std::filesystem::path& work_tree, const std::filesystem::path& git_dir);
+
+    /// Add the .gitignore of `dir` ("" for the root, otherwise "a/b")
+    void enter(const std::string& dir);
+    /// Drop the patterns added by the matching enter()
+    void leave();
+
+    /// @param rel Path relative to the work tree, '/'-separated
+    bool ignored(std::string_view rel, bool is_dir) const;
+
+private:
+    std::filesystem::path work_tree_;
+    std::vector<std::vector<GitIgnorePattern>> levels_;   // [0] = info/exclude, then one per entered directory
+};
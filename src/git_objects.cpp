@@ -0,0 +1,606 @@
+#include "git_objects.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// ----------------------------------------------------------------------------
+// SHA-1 (only used to confirm racily-clean / stat-dirty index entries)
+// ----------------------------------------------------------------------------
+class Sha1 {
+public:
+    void update(const unsigned char* data, size_t len) {
+        total_ += len;
+        if(buf_len_ > 0) {
+            size_t take = std::min(len, sizeof(buf_) - buf_len_);
+            std::memcpy(buf_ + buf_len_, data, take);
+            buf_len_ += take;
+            data += take;
+            len -= take;
+            if(buf_len_ < sizeof(buf_)) {
+                return;
+            }
+            block(buf_);
+            buf_len_ = 0;
+        }
+        for(; len >= 64; data += 64, len -= 64) {
+            block(data);
+        }
+        std::memcpy(buf_, data, len);
+        buf_len_ = len;
+    }
+
+    void update(std::string_view s) {
+        update(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+    }
+
+    GitOid finish() {
+        const uint64_t bits = total_ * 8;
+        const unsigned char pad = 0x80;
+        const unsigned char zero[64] = {};
+        update(&pad, 1);
+        update(zero, (buf_len_ <= 56) ? 56 - buf_len_ : 120 - buf_len_);
+        unsigned char len_be[8];
+        for(int i = 0; i < 8; i++) {
+            len_be[i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+        }
+        update(len_be, 8);
+        GitOid out;
+        for(int i = 0; i < 5; i++) {
+            for(int j = 0; j < 4; j++) {
+                out[4 * i + j] = static_cast<unsigned char>(h_[i] >> (24 - 8 * j));
+            }
+        }
+        return out;
+    }
+
+private:
+    static uint32_t rol(uint32_t v, int n) { return (v << n) | (v >> (32 - n)); }
+
+    void block(const unsigned char* p) {
+        uint32_t w[80];
+        for(int i = 0; i < 16; i++) {
+            w[i] = (uint32_t(p[4 * i]) << 24) | (uint32_t(p[4 * i + 1]) << 16) |
+                   (uint32_t(p[4 * i + 2]) << 8) | uint32_t(p[4 * i + 3]);
+        }
+        for(int i = 16; i < 80; i++) {
+            w[i] = rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h_[0], b = h_[1], c = h_[2], d = h_[3], e = h_[4];
+        for(int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if(i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if(i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if(i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else            { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t t = rol(a, 5) + f + e + k + w[i];
+            e = d; d = c; c = rol(b, 30); b = a; a = t;
+        }
+        h_[0] += a; h_[1] += b; h_[2] += c; h_[3] += d; h_[4] += e;
+    }
+
+    uint32_t h_[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    unsigned char buf_[64] = {};
+    size_t buf_len_{0};
+    uint64_t total_{0};
+};
+
+bool read_whole_file(const fs::path& path, std::string& out) {
+    std::ifstream ifs(path, std::ios::binary);
+    if(!ifs) {
+        return false;
+    }
+    out.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+    return true;
+}
+
+std::string first_line(const fs::path& path) {
+    std::ifstream ifs(path);
+    std::string line;
+    std::getline(ifs, line);
+    while(!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+        line.pop_back();
+    }
+    return line;
+}
+
+uint32_t read_be32(const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * Inflate one zlib stream starting at `offset` in `ifs`, reading the
+ * compressed input in blocks until the end of the stream.
+ */
+bool inflate_at(std::ifstream& ifs, uint64_t offset, std::string& out, size_t size_hint) {
+    z_stream zs{};
+    if(inflateInit(&zs) != Z_OK) {
+        return false;
+    }
+    ifs.clear();
+    ifs.seekg(static_cast<std::streamoff>(offset));
+    out.clear();
+    out.resize(size_hint ? size_hint : 4096);
+    size_t produced = 0;
+    char in[16 * 1024];
+    int ret = Z_OK;
+    while(ret != Z_STREAM_END) {
+        if(zs.avail_in == 0) {
+            ifs.read(in, sizeof(in));
+            auto got = ifs.gcount();
+            if(got <= 0) {
+                break;
+            }
+            zs.next_in = reinterpret_cast<Bytef*>(in);
+            zs.avail_in = static_cast<uInt>(got);
+        }
+        if(produced == out.size()) {
+            out.resize(out.size() * 2 + 1);
+        }
+        zs.next_out = reinterpret_cast<Bytef*>(out.data() + produced);
+        zs.avail_out = static_cast<uInt>(out.size() - produced);
+        ret = inflate(&zs, Z_NO_FLUSH);
+        produced = out.size() - zs.avail_out;
+        if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+            break;
+        }
+    }
+    inflateEnd(&zs);
+    out.resize(produced);
+    return ret == Z_STREAM_END;
+}
+#endif
+
+/// Rebuild an object from its delta base; every size and range is checked
+/// against the base and the delta, so corrupt packs fail instead of overrunning
+bool apply_delta(const std::string& base, const std::string& delta, std::string& out) {
+    size_t pos = 0;
+    auto varint = [&](uint64_t& v) {
+        v = 0;
+        for(int shift = 0; pos < delta.size() && shift < 64; shift += 7) {
+            unsigned char c = delta[pos++];
+            v |= uint64_t(c & 0x7f) << shift;
+            if(!(c & 0x80)) return true;
+        }
+        return false;
+    };
+    uint64_t base_size = 0, result_size = 0;
+    if(!varint(base_size) || base_size != base.size() || !varint(result_size)) {
+        return false;
+    }
+    out.clear();
+    // The header is untrusted: don't let it size the allocation by itself
+    out.reserve(std::min<uint64_t>(result_size, base.size() + delta.size()));
+    while(pos < delta.size()) {
+        unsigned char op = delta[pos++];
+        if(op & 0x80) {
+            uint64_t off = 0, size = 0;
+            for(int i = 0; i < 7; i++) {
+                if(!(op & (1 << i))) continue;
+                if(pos >= delta.size()) return false;
+                const uint64_t byte = static_cast<unsigned char>(delta[pos++]);
+                if(i < 4) off |= byte << (8 * i);
+                else size |= byte << (8 * (i - 4));
+            }
+            if(size == 0) size = 0x10000;
+            if(off > base.size() || size > base.size() - off || size > result_size - out.size()) {
+                return false;
+            }
+            out.append(base, off, size);
+        } else if(op != 0) {
+            if(op > delta.size() - pos || op > result_size - out.size()) return false;
+            out.append(delta, pos, op);
+            pos += op;
+        } else {
+            return false;
+        }
+    }
+    return out.size() == result_size;
+}
+
+const char* pack_type_name(int type) {
+    switch(type) {
+        case 1: return "commit";
+        case 2: return "tree";
+        case 3: return "blob";
+        case 4: return "tag";
+        default: return nullptr;
+    }
+}
+
+} // namespace
+
+std::string oid_to_hex(const GitOid& oid) {
+    static constexpr char hex[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(40);
+    for(unsigned char c : oid) {
+        out.push_back(hex[c >> 4]);
+        out.push_back(hex[c & 0x0f]);
+    }
+    return out;
+}
+
+std::optional<GitOid> oid_from_hex(std::string_view hex) {
+    if(hex.size() != 40) {
+        return std::nullopt;
+    }
+    auto nibble = [](char c) -> int {
+        if(c >= '0' && c <= '9') return c - '0';
+        if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    GitOid oid;
+    for(size_t i = 0; i < 20; i++) {
+        int hi = nibble(hex[2 * i]);
+        int lo = nibble(hex[2 * i + 1]);
+        if(hi < 0 || lo < 0) {
+            return std::nullopt;
+        }
+        oid[i] = static_cast<unsigned char>((hi << 4) | lo);
+    }
+    return oid;
+}
+
+GitOid hash_blob(std::string_view content) {
+    Sha1 sha;
+    sha.update("blob " + std::to_string(content.size()));
+    const unsigned char nul = 0;
+    sha.update(&nul, 1);
+    sha.update(content);
+    return sha.finish();
+}
+
+fs::path find_git_dir(const fs::path& repo_path) {
+    std::error_code ec;
+    fs::path dot_git = repo_path / ".git";
+    if(fs::is_directory(dot_git, ec)) {
+        return dot_git;
+    }
+    if(fs::is_regular_file(dot_git, ec)) {
+        // Linked worktree or submodule: ".git" is a file pointing at the real directory
+        auto line = first_line(dot_git);
+        const std::string prefix = "gitdir: ";
+        if(line.rfind(prefix, 0) == 0) {
+            fs::path dir(line.substr(prefix.size()));
+            return dir.is_absolute() ? dir : repo_path / dir;
+        }
+    }
+    return {};
+}
+
+// ----------------------------------------------------------------------------
+// GitObjectStore
+// ----------------------------------------------------------------------------
+GitObjectStore::GitObjectStore(fs::path git_dir)
+    : git_dir_(std::move(git_dir)), common_dir_(git_dir_)
+{
+    // Linked worktrees keep refs and objects in the main repository's git dir
+    std::error_code ec;
+    if(fs::exists(git_dir_ / "commondir", ec)) {
+        fs::path common(first_line(git_dir_ / "commondir"));
+        common_dir_ = common.is_absolute() ? common : git_dir_ / common;
+    }
+}
+
+bool GitObjectStore::available() {
+#ifdef HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool GitObjectStore::read(const GitOid& oid, std::string& type, std::string& data) {
+    return read_loose(oid, type, data) || read_packed(oid, type, data);
+}
+
+bool GitObjectStore::read_loose(const GitOid& oid, std::string& type, std::string& data) {
+#ifdef HAVE_ZLIB
+    auto hex = oid_to_hex(oid);
+    fs::path path = common_dir_ / "objects" / hex.substr(0, 2) / hex.substr(2);
+    std::ifstream ifs(path, std::ios::binary);
+    if(!ifs) {
+        return false;
+    }
+    std::string raw;
+    if(!inflate_at(ifs, 0, raw, 0)) {
+        return false;
+    }
+    // "<type> <size>\0<payload>"
+    auto sp = raw.find(' ');
+    auto nul = raw.find('\0');
+    if(sp == std::string::npos || nul == std::string::npos || sp > nul) {
+        return false;
+    }
+    type = raw.substr(0, sp);
+    data = raw.substr(nul + 1);
+    return true;
+#else
+    (void)oid; (void)type; (void)data;
+    return false;
+#endif
+}
+
+void GitObjectStore::load_packs() {
+    packs_loaded_ = true;
+    std::error_code ec;
+    fs::path pack_dir = common_dir_ / "objects" / "pack";
+    for(const auto& entry : fs::directory_iterator(pack_dir, ec)) {
+        if(entry.path().extension() != ".idx") {
+            continue;
+        }
+        PackIndex pack;
+        std::string raw;
+        if(!read_whole_file(entry.path(), raw) || raw.size() < 8 + 1024) {
+            continue;
+        }
+        pack.idx.assign(raw.begin(), raw.end());
+        const unsigned char* p = pack.idx.data();
+        // Only the version 2 format ("\377tOc", version 2) is supported
+        if(std::memcmp(p, "\377tOc", 4) != 0 || read_be32(p + 4) != 2) {
+            spdlog::debug("Skipping unsupported pack index: {}", entry.path().string());
+            continue;
+        }
+        pack.count = read_be32(p + 8 + 255 * 4);
+        pack.pack_path = entry.path();
+        pack.pack_path.replace_extension(".pack");
+        packs_.push_back(std::move(pack));
+    }
+}
+
+bool GitObjectStore::read_packed(const GitOid& oid, std::string& type, std::string& data) {
+    if(!packs_loaded_) {
+        load_packs();
+    }
+    for(const auto& pack : packs_) {
+        const unsigned char* fanout = pack.idx.data() + 8;
+        const unsigned char* oids = fanout + 1024;
+        uint32_t lo = oid[0] == 0 ? 0 : read_be32(fanout + 4 * (oid[0] - 1));
+        uint32_t hi = read_be32(fanout + 4 * oid[0]);
+        while(lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            int cmp = std::memcmp(oids + 20 * size_t(mid), oid.data(), 20);
+            if(cmp == 0) {
+                const unsigned char* offsets = oids + 24 * size_t(pack.count);
+                uint64_t off = read_be32(offsets + 4 * size_t(mid));
+                if(off & 0x80000000u) {
+                    const unsigned char* large = offsets + 4 * size_t(pack.count) + 8 * (off & 0x7fffffffu);
+                    off = (uint64_t(read_be32(large)) << 32) | read_be32(large + 4);
+                }
+                return read_pack_at(pack, off, type, data, 0);
+            }
+            if(cmp < 0) lo = mid + 1;
+            else hi = mid;
+        }
+    }
+    return false;
+}
+
+bool GitObjectStore::read_pack_at(const PackIndex& pack, uint64_t offset,
+                                  std::string& type, std::string& data, int depth)
+{
+#ifdef HAVE_ZLIB
+    if(depth > 64) {
+        return false;
+    }
+    std::ifstream ifs(pack.pack_path, std::ios::binary);
+    if(!ifs) {
+        return false;
+    }
+    unsigned char hdr[32];
+    ifs.seekg(static_cast<std::streamoff>(offset));
+    ifs.read(reinterpret_cast<char*>(hdr), sizeof(hdr));
+    size_t got = static_cast<size_t>(ifs.gcount());
+    size_t pos = 0;
+    if(got == 0) {
+        return false;
+    }
+    unsigned char c = hdr[pos++];
+    int obj_type = (c >> 4) & 7;
+    uint64_t size = c & 15;
+    int shift = 4;
+    while((c & 0x80) && pos < got) {
+        c = hdr[pos++];
+        size |= uint64_t(c & 0x7f) << shift;
+        shift += 7;
+    }
+
+    if(obj_type == 6 || obj_type == 7) {
+        std::string base;
+        if(obj_type == 6) {
+            // OFS_DELTA: base is earlier in the same pack
+            c = hdr[pos++];
+            uint64_t rel = c & 0x7f;
+            while((c & 0x80) && pos < got) {
+                c = hdr[pos++];
+                rel = ((rel + 1) << 7) | (c & 0x7f);
+            }
+            if(rel > offset || !read_pack_at(pack, offset - rel, type, base, depth + 1)) {
+                return false;
+            }
+        } else {
+            // REF_DELTA: base is named by object id
+            if(pos + 20 > got) {
+                return false;
+            }
+            GitOid base_oid;
+            std::copy_n(hdr + pos, 20, base_oid.begin());
+            pos += 20;
+            if(!read(base_oid, type, base)) {
+                return false;
+            }
+        }
+        std::string delta;
+        if(!inflate_at(ifs, offset + pos, delta, size)) {
+            return false;
+        }
+        return apply_delta(base, delta, data);
+    }
+
+    const char* name = pack_type_name(obj_type);
+    if(!name) {
+        return false;
+    }
+    type = name;
+    return inflate_at(ifs, offset + pos, data, size);
+#else
+    (void)pack; (void)offset; (void)type; (void)data; (void)depth;
+    return false;
+#endif
+}
+
+std::optional<GitOid> GitObjectStore::resolve_ref(const std::string& name, int depth) {
+    if(depth > 8) {
+        return std::nullopt;
+    }
+    if(auto oid = oid_from_hex(name)) {
+        return oid;
+    }
+    // Same lookup order as git rev-parse
+    const std::vector<std::string> candidates{
+        name,
+        "refs/" + name,
+        "refs/tags/" + name,
+        "refs/heads/" + name,
+        "refs/remotes/" + name,
+        "refs/remotes/" + name + "/HEAD",
+    };
+    std::string packed;
+    bool packed_loaded = false;
+    for(const auto& ref : candidates) {
+        for(const auto& dir : {git_dir_, common_dir_}) {
+            std::error_code ec;
+            fs::path path = dir / ref;
+            if(!fs::is_regular_file(path, ec)) {
+                continue;
+            }
+            auto line = first_line(path);
+            if(line.rfind("ref: ", 0) == 0) {
+                return resolve_ref(line.substr(5), depth + 1);
+            }
+            if(auto oid = oid_from_hex(line)) {
+                return oid;
+            }
+        }
+        if(!packed_loaded) {
+            read_whole_file(common_dir_ / "packed-refs", packed);
+            packed_loaded = true;
+        }
+        // packed-refs lines: "<hex> <refname>"
+        size_t pos = 0;
+        while(pos < packed.size()) {
+            size_t eol = packed.find('\n', pos);
+            if(eol == std::string::npos) eol = packed.size();
+            std::string_view line(packed.data() + pos, eol - pos);
+            pos = eol + 1;
+            if(line.size() > 41 && line[40] == ' ' && line.substr(41) == ref) {
+                return oid_from_hex(line.substr(0, 40));
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<GitOid> GitObjectStore::peel_to_commit(GitOid oid) {
+    std::string type, data;
+    for(int i = 0; i < 8; i++) {
+        if(!read(oid, type, data)) {
+            return std::nullopt;
+        }
+        if(type == "commit") {
+            return oid;
+        }
+        if(type != "tag" || data.rfind("object ", 0) != 0) {
+            return std::nullopt;
+        }
+        auto next = oid_from_hex(std::string_view(data).substr(7, 40));
+        if(!next) {
+            return std::nullopt;
+        }
+        oid = *next;
+    }
+    return std::nullopt;
+}
+
+std::optional<GitOid> GitObjectStore::resolve_tree(const std::string& rev) {
+    auto op_pos = rev.find_first_of("~^");
+    auto oid = resolve_ref(rev.substr(0, op_pos));
+    if(!oid) {
+        return std::nullopt;
+    }
+
+    std::string type, data;
+    if(op_pos == std::string::npos) {
+        // A bare tree id is accepted as-is
+        if(read(*oid, type, data) && type == "tree") {
+            return oid;
+        }
+    }
+    auto commit = peel_to_commit(*oid);
+    if(!commit) {
+        return std::nullopt;
+    }
+
+    // Walk ~N / ^N suffixes (both follow parents; ^N picks the Nth parent)
+    size_t pos = op_pos;
+    while(pos != std::string::npos && pos < rev.size()) {
+        char op = rev[pos++];
+        size_t digits_end = pos;
+        while(digits_end < rev.size() && std::isdigit(static_cast<unsigned char>(rev[digits_end]))) {
+            digits_end++;
+        }
+        int n = 1;
+        if(digits_end > pos) {
+            auto [ptr, ec] = std::from_chars(rev.data() + pos, rev.data() + digits_end, n);
+            if(ec != std::errc()) {
+                return std::nullopt;
+            }
+        }
+        pos = digits_end;
+        int steps = (op == '~') ? n : (n == 0 ? 0 : 1);
+        int parent_index = (op == '^') ? n : 1;
+        for(int s = 0; s < steps; s++) {
+            if(!read(*commit, type, data) || type != "commit") {
+                return std::nullopt;
+            }
+            int seen = 0;
+            std::optional<GitOid> parent;
+            size_t line_start = 0;
+            while(line_start < data.size() && data[line_start] != '\n') {
+                size_t eol = data.find('\n', line_start);
+                if(eol == std::string::npos) {
+                    break;
+                }
+                std::string_view line(data.data() + line_start, eol - line_start);
+                if(line.rfind("parent ", 0) == 0 && ++seen == parent_index) {
+                    parent = oid_from_hex(line.substr(7));
+                    break;
+                }
+                line_start = eol + 1;
+            }
+            if(!parent) {
+                return std::nullopt;
+            }
+            commit = parent;
+        }
+    }
+
+    if(!read(*commit, type, data) || type != "commit" || data.rfind("tree ", 0) != 0) {
+        return std::nullopt;
+    }
+    return oid_from_hex(std::string_view(data).substr(5, 40));
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using GitOid = std::array<unsigned char, 20>;
+
+std::string oid_to_hex(const GitOid& oid);
+std::optional<GitOid> oid_from_hex(std::string_view hex);
+
+/**
+ * @brief SHA-1 object id of a blob with the given content ("blob <size>\0<content>").
+ */
+GitOid hash_blob(std::string_view content);
+
+/**
+ * @brief Locate the git directory for a working tree (follows a ".git" file
+ *        containing "gitdir: <path>").
+ * @return empty path if repo_path is not a git working tree
+ */
+std::filesystem::path find_git_dir(const std::filesystem::path& repo_path);
+
+/**
+ * @brief Read-only access to a repository's object database (loose objects and
+ *        pack files) plus ref resolution.
+ *
+ * Object reads need zlib; without it (HAVE_ZLIB undefined) available() is false
+ * and every read fails.
+ */
+class GitObjectStore {
+public:
+    explicit GitObjectStore(std::filesystem::path git_dir);
+
+    static bool available();
+
+    /**
+     * @brief Read an object, resolving pack deltas.
+     * @param type Receives "commit", "tree", "blob" or "tag"
+     */
+    bool read(const GitOid& oid, std::string& type, std::string& data);
+
+    /**
+     * @brief Resolve a revision to a tree id. Accepts full object ids, ref names
+     *        (HEAD, branch, tag, remote, refs/...) and ~N / ^ suffixes.
+     */
+    std::optional<GitOid> resolve_tree(const std::string& rev);
+
+private:
+    struct PackIndex {
+        std::filesystem::path pack_path;
+        std::vector<unsigned char> idx;   // raw .idx (version 2)
+        uint32_t count{0};
+    };
+
+    std::optional<GitOid> resolve_ref(const std::string& name, int depth = 0);
+    std::optional<GitOid> peel_to_commit(GitOid oid);
+    bool read_loose(const GitOid& oid, std::string& type, std::string& data);
+    bool read_packed(const GitOid& oid, std::string& type, std::string& data);
+    bool read_pack_at(const PackIndex& pack, uint64_t offset, std::string& type, std::string& data, int depth);
+    void load_packs();
+
+    std::filesystem::path git_dir_;
+    std::filesystem::path common_dir_;   // differs from git_dir_ in linked worktrees
+    std::vector<PackIndex> packs_;
+    bool packs_loaded_{false};
+};
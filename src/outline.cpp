@@ -0,0 +1,848 @@
+#include "outline.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace {
+
+bool is_ident(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+
+bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+bool all_blank(std::string_view s) {
+    return std::all_of(s.begin(), s.end(), [](char c) { return is_blank(c) || c == '\n'; });
+}
+
+std::string_view trim(std::string_view s) {
+    while(!s.empty() && (is_blank(s.front()) || s.front() == '\n')) s.remove_prefix(1);
+    while(!s.empty() && (is_blank(s.back()) || s.back() == '\n')) s.remove_suffix(1);
+    return s;
+}
+
+/// Position of the last whole-word occurrence of `word` in `text`, or npos
+size_t find_word(std::string_view text, std::string_view word) {
+    size_t pos = text.size();
+    while(pos > 0) {
+        pos = text.rfind(word, pos - 1);
+        if(pos == std::string_view::npos) {
+            return pos;
+        }
+        bool start_ok = pos == 0 || !is_ident(text[pos - 1]);
+        size_t end = pos + word.size();
+        bool end_ok = end >= text.size() || !is_ident(text[end]);
+        if(start_ok && end_ok) {
+            return pos;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// ----------------------------------------------------------------------------
+// Brace languages (C/C++, Go, Java, JavaScript/TypeScript, Rust)
+// ----------------------------------------------------------------------------
+class BraceOutliner {
+public:
+    BraceOutliner(std::string_view src, SourceLanguage lang) : s_(src), lang_(lang) {
+        out_.reserve(src.size() / 2);
+    }
+
+    std::string run() {
+        size_t pos = 0;
+        char prev_sig = '\n';
+        while(pos < s_.size()) {
+            const char c = s_[pos];
+            if(lang_ == SourceLanguage::CFamily && c == '#' && at_line_start()) {
+                pos = copy_directive(pos);
+                header_start_ = out_.size();
+                continue;
+            }
+            size_t end = literal_end(pos, prev_sig);
+            if(end != pos) {
+                pos = emit_literal(pos, end);
+                prev_sig = '"';
+                continue;
+            }
+            if(c == '{') {
+                const std::string_view header = std::string_view(out_).substr(header_start_);
+                if(is_type_literal(header) || is_member_initializer(header)) {
+                    // TypeScript `f(): { a: number } {` or C++ `Foo() : b_{x} {`:
+                    // the braces are part of the header
+                    end = skip_block(pos);
+                    out_.append(s_.substr(pos, end - pos));
+                    pos = end;
+                    prev_sig = '}';
+                    continue;
+                }
+                if(is_body(header)) {
+                    out_ += "{ ... }";
+                    pos = skip_block(pos);
+                    header_start_ = out_.size();
+                    prev_sig = '}';
+                    continue;
+                }
+                out_ += c;
+                header_start_ = out_.size();
+            } else if(c == '}' || c == ';') {
+                out_ += c;
+                header_start_ = out_.size();
+            } else if(c == '\n') {
+                out_ += c;
+                last_line_comment_ = cur_line_comment_;
+                cur_line_comment_ = false;
+                line_start_ = out_.size();
+            } else {
+                out_ += c;
+            }
+            if(!is_blank(c) && c != '\n') {
+                prev_sig = c;
+            }
+            pos++;
+        }
+        return std::move(out_);
+    }
+
+private:
+    bool at_line_start() const {
+        return all_blank(std::string_view(out_).substr(line_start_));
+    }
+
+    /// Preprocessor directive, including backslash continuations
+    size_t copy_directive(size_t pos) {
+        size_t end = pos;
+        while(end < s_.size() && s_[end] != '\n') {
+            if(s_[end] == '\\' && end + 1 < s_.size() && s_[end + 1] == '\n') {
+                end += 2;
+                continue;
+            }
+            end++;
+        }
+        out_.append(s_.substr(pos, end - pos));
+        return end;
+    }
+
+    /**
+     * If a comment, string, character or regex literal starts at pos, return
+     * the position just past it. Otherwise return pos.
+     */
+    size_t literal_end(size_t pos, char prev_sig) const {
+        const size_t n = s_.size();
+        const char c = s_[pos];
+        const char next = pos + 1 < n ? s_[pos + 1] : '\0';
+
+        if(c == '/' && next == '/') {
+            size_t nl = s_.find('\n', pos);
+            return nl == std::string_view::npos ? n : nl;
+        }
+        if(c == '/' && next == '*') {
+            size_t close = s_.find("*/", pos + 2);
+            return close == std::string_view::npos ? n : close + 2;
+        }
+        if(c == '"') {
+            if(lang_ == SourceLanguage::CFamily && pos > 0 && s_[pos - 1] == 'R') {
+                // C++ raw string R"delim( ... )delim"
+                size_t open = s_.find('(', pos);
+                if(open != std::string_view::npos && open - pos <= 17) {
+                    std::string close = ")" + std::string(s_.substr(pos + 1, open - pos - 1)) + "\"";
+                    size_t end = s_.find(close, open);
+                    return end == std::string_view::npos ? n : end + close.size();
+                }
+            }
+            return quoted_end(pos, '"', lang_ == SourceLanguage::Rust);
+        }
+        if(c == '\'') {
+            return char_literal_end(pos);
+        }
+        if(c == '`' && (lang_ == SourceLanguage::JavaScript || lang_ == SourceLanguage::Go)) {
+            return quoted_end(pos, '`', true, lang_ == SourceLanguage::JavaScript);
+        }
+        if(lang_ == SourceLanguage::Rust && (c == 'r' || c == 'b')) {
+            return rust_raw_string_end(pos);
+        }
+        if(lang_ == SourceLanguage::JavaScript && c == '/' &&
+           std::string_view("(,=:[!&|?{};+-*%<>~^\n").find(prev_sig) != std::string_view::npos) {
+            return regex_end(pos);
+        }
+        return pos;
+    }
+
+    size_t quoted_end(size_t pos, char quote, bool multiline, bool escapes = true) const {
+        for(size_t i = pos + 1; i < s_.size(); i++) {
+            const char c = s_[i];
+            if(escapes && c == '\\') {
+                i++;
+            } else if(c == quote) {
+                return i + 1;
+            } else if(c == '\n' && !multiline) {
+                return i;
+            }
+        }
+        return s_.size();
+    }
+
+    size_t char_literal_end(size_t pos) const {
+        if(lang_ == SourceLanguage::Rust) {
+            // 'a' or '\n' is a char; 'a without a closing quote is a lifetime
+            if(pos + 1 < s_.size() && s_[pos + 1] == '\\') {
+                return quoted_end(pos, '\'', false);
+            }
+            for(size_t i = pos + 2; i < s_.size() && i <= pos + 5; i++) {
+                if(s_[i] == '\'') return i + 1;
+                if(is_ident(s_[i]) || s_[i] == '\n') break;
+            }
+            return pos;
+        }
+        if(lang_ == SourceLanguage::CFamily && pos > 0 &&
+           std::isdigit(static_cast<unsigned char>(s_[pos - 1]))) {
+            return pos;   // digit separator: 1'000'000
+        }
+        return quoted_end(pos, '\'', false);
+    }
+
+    size_t rust_raw_string_end(size_t pos) const {
+        if(pos > 0 && is_ident(s_[pos - 1])) {
+            return pos;
+        }
+        size_t i = pos;
+        if(s_[i] == 'b') i++;
+        if(i >= s_.size() || s_[i] != 'r') {
+            return pos;
+        }
+        i++;
+        size_t hashes = 0;
+        while(i < s_.size() && s_[i] == '#') {
+            hashes++;
+            i++;
+        }
+        if(i >= s_.size() || s_[i] != '"') {
+            return pos;
+        }
+        std::string close = "\"" + std::string(hashes, '#');
+        size_t end = s_.find(close, i + 1);
+        return end == std::string_view::npos ? s_.size() : end + close.size();
+    }
+
+    size_t regex_end(size_t pos) const {
+        bool in_class = false;
+        for(size_t i = pos + 1; i < s_.size(); i++) {
+            const char c = s_[i];
+            if(c == '\\') {
+                i++;
+            } else if(c == '\n') {
+                return pos;   // not a regex after all (division)
+            } else if(c == '[') {
+                in_class = true;
+            } else if(c == ']') {
+                in_class = false;
+            } else if(c == '/' && !in_class) {
+                return i + 1;
+            }
+        }
+        return pos;
+    }
+
+    /// Copy a literal; comments are summarised. Returns the position to continue at.
+    size_t emit_literal(size_t begin, size_t end) {
+        std::string_view lit = s_.substr(begin, end - begin);
+        const bool comment = lit.size() >= 2 && lit[0] == '/' && (lit[1] == '/' || lit[1] == '*');
+        if(!comment) {
+            out_.append(lit);
+            return end;
+        }
+        const bool header_empty = all_blank(std::string_view(out_).substr(header_start_));
+        if(lit[1] == '/') {
+            if(at_line_start()) {
+                if(last_line_comment_) {
+                    // Only the first line of a run of line comments is kept
+                    out_.resize(line_start_);
+                    return (end < s_.size() && s_[end] == '\n') ? end + 1 : end;
+                }
+                cur_line_comment_ = true;
+            }
+            out_.append(lit);
+        } else if(lit.find('\n') == std::string_view::npos) {
+            out_.append(lit);
+        } else {
+            append_block_summary(lit);
+        }
+        if(header_empty) {
+            header_start_ = out_.size();
+        }
+        return end;
+    }
+
+    /// "/** \n * Summary line.\n * more...\n */" -> "/** Summary line. */"
+    void append_block_summary(std::string_view lit) {
+        size_t open_len = 2;
+        while(open_len < lit.size() && (lit[open_len] == '*' || lit[open_len] == '!')) open_len++;
+        std::string_view body = lit.substr(open_len, lit.size() - open_len - 2);
+        std::string_view summary;
+        size_t pos = 0;
+        while(pos <= body.size() && summary.empty()) {
+            size_t nl = body.find('\n', pos);
+            if(nl == std::string_view::npos) nl = body.size();
+            auto line = trim(body.substr(pos, nl - pos));
+            while(!line.empty() && line.front() == '*') line.remove_prefix(1);
+            summary = trim(line);
+            pos = nl + 1;
+        }
+        out_.append(lit.substr(0, open_len));
+        if(!summary.empty()) {
+            out_ += ' ';
+            out_.append(summary);
+        }
+        out_ += " */";
+    }
+
+    /// Skip a balanced { ... } block starting at pos; returns the position after it
+    size_t skip_block(size_t pos) const {
+        int depth = 0;
+        char prev_sig = '{';
+        while(pos < s_.size()) {
+            size_t end = literal_end(pos, prev_sig);
+            if(end != pos) {
+                pos = end;
+                prev_sig = '"';
+                continue;
+            }
+            const char c = s_[pos++];
+            if(c == '{') {
+                depth++;
+            } else if(c == '}' && --depth == 0) {
+                return pos;
+            }
+            if(!is_blank(c) && c != '\n') {
+                prev_sig = c;
+            }
+        }
+        return pos;
+    }
+
+    /// A '{' after a return type annotation (`): {`, `): A & {`) opens an object type, not a block
+    bool is_type_literal(std::string_view header) const {
+        if(lang_ != SourceLanguage::JavaScript) {
+            return false;
+        }
+        const std::string cleaned = header_code(header);
+        auto code = trim(cleaned);
+        if(code.ends_with(':')) {
+            code = trim(code.substr(0, code.size() - 1));
+            return code.ends_with(')');
+        }
+        return code.ends_with('|') || code.ends_with('&');
+    }
+
+    /// A '{' right after a name in a constructor's mem-initializer list (`Foo(int x) : a_(x), b_{`)
+    bool is_member_initializer(std::string_view header) const {
+        if(lang_ != SourceLanguage::CFamily) {
+            return false;
+        }
+        const std::string code = header_code(header);
+        const std::vector<bool> top = top_level_mask(code);
+        // The list starts at a top-level ':' after the parameter list
+        size_t params_end = std::string_view::npos;
+        size_t delim = std::string_view::npos;
+        for(size_t i = 0; i < code.size(); i++) {
+            if(!top[i]) {
+                continue;
+            }
+            if(code[i] == '(' && params_end == std::string_view::npos) {
+                params_end = group_end(code, i);
+                i = params_end - 1;
+            } else if(code[i] == ':' && params_end != std::string_view::npos) {
+                if(code.compare(i, 2, "::") == 0) {
+                    i++;
+                } else if(delim == std::string_view::npos) {
+                    delim = i;
+                }
+            } else if(code[i] == ',' && delim != std::string_view::npos) {
+                delim = i;
+            }
+        }
+        if(delim == std::string_view::npos) {
+            return false;
+        }
+        // The current initializer must be just a (qualified, possibly templated) name
+        auto name = trim(std::string_view(code).substr(delim + 1));
+        return !name.empty() && (is_ident(name.back()) || name.back() == '>') &&
+               name.find_first_of("(){}") == std::string_view::npos;
+    }
+
+    /// Copy of a header with comments and string/char literals blanked out
+    static std::string header_code(std::string_view h) {
+        std::string code(h);
+        auto blank = [&](size_t from, size_t to) {
+            for(size_t k = from; k < to && k < code.size(); k++) {
+                if(code[k] != '\n') code[k] = ' ';
+            }
+        };
+        for(size_t i = 0; i < h.size(); i++) {
+            const char c = h[i];
+            const char next = i + 1 < h.size() ? h[i + 1] : '\0';
+            size_t end = i;
+            if(c == '/' && next == '/') {
+                end = std::min(h.find('\n', i), h.size());
+            } else if(c == '/' && next == '*') {
+                size_t close = h.find("*/", i + 2);
+                end = close == std::string_view::npos ? h.size() : close + 2;
+            } else if(c == '"' || c == '`') {
+                end = i + 1;
+                while(end < h.size() && h[end] != c) end += (h[end] == '\\') ? 2 : 1;
+                end = std::min(end + 1, h.size());
+            } else if(c == '\'') {
+                // Character literal, but not a Rust lifetime ('a)
+                size_t close = h.find('\'', i + 1);
+                if(close != std::string_view::npos && close - i <= 4) end = close + 1;
+            }
+            if(end > i) {
+                blank(i, end);
+                i = end - 1;
+            }
+        }
+        return code;
+    }
+
+    /// For each position, whether it is outside all (), [], {} and <> groups
+    static std::vector<bool> top_level_mask(std::string_view code) {
+        std::vector<bool> top(code.size());
+        int depth = 0, angle = 0;
+        for(size_t i = 0; i < code.size(); i++) {
+            const char c = code[i];
+            top[i] = depth == 0 && angle == 0;
+            if(c == '(' || c == '[' || c == '{') {
+                depth++;
+            } else if((c == ')' || c == ']' || c == '}') && depth > 0) {
+                depth--;
+            } else if(c == '<') {
+                // Generic arguments follow a name ("Vec<", "impl<", "template <"), operator< doesn't
+                size_t j = i;
+                while(j > 0 && is_blank(code[j - 1])) j--;
+                size_t w = j;
+                while(w > 0 && is_ident(code[w - 1])) w--;
+                std::string_view word = code.substr(w, j - w);
+                if(!word.empty() && (j == i || word == "template") && word != "operator") {
+                    angle++;
+                }
+            } else if(c == '>' && angle > 0 && i > 0 && code[i - 1] != '-' && code[i - 1] != '=') {
+                angle--;
+            }
+        }
+        return top;
+    }
+
+    /// Position of the last top-level whole-word occurrence of `word`, or npos
+    static size_t find_top_word(std::string_view code, const std::vector<bool>& top, std::string_view word) {
+        size_t pos = code.size();
+        while(pos > 0) {
+            pos = find_word(code.substr(0, pos), word);
+            if(pos == std::string_view::npos || top[pos]) return pos;
+        }
+        return std::string_view::npos;
+    }
+
+    static bool is_attribute_word(std::string_view w) {
+        return w == "__attribute__" || w == "__declspec" || w == "alignas" || w == "_Alignas" ||
+               w == "decltype" || w == "__align__";
+    }
+
+    /// Index just past the balanced group opened at code[open]
+    static size_t group_end(std::string_view code, size_t open) {
+        const char o = code[open];
+        const char c = o == '(' ? ')' : o == '[' ? ']' : o == '{' ? '}' : '>';
+        int depth = 0;
+        for(size_t i = open; i < code.size(); i++) {
+            if(code[i] == o) depth++;
+            else if(code[i] == c && --depth == 0) return i + 1;
+        }
+        return code.size();
+    }
+
+    static size_t skip_blanks(std::string_view code, size_t i) {
+        while(i < code.size() && (is_blank(code[i]) || code[i] == '\n')) i++;
+        return i;
+    }
+
+    /**
+     * Decide whether the '{' after `header` opens a function body (dropped) or
+     * a container/initializer (kept). A container keyword followed by the
+     * type's name wins, so primary constructors (Kotlin `class Foo(val x: Int)`,
+     * Java records) stay containers. Otherwise it is a function when a
+     * top-level parameter list directly follows a name; parentheses of
+     * attributes, alignas and generic arguments don't count.
+     */
+    bool is_body(std::string_view header) const {
+        static constexpr std::array<std::string_view, 6> c_words{"class", "struct", "union", "namespace", "enum", "extern"};
+        static constexpr std::array<std::string_view, 2> go_words{"struct", "interface"};
+        static constexpr std::array<std::string_view, 6> java_words{"class", "interface", "enum", "record", "namespace", "object"};
+        static constexpr std::array<std::string_view, 5> js_words{"class", "interface", "enum", "namespace", "module"};
+        static constexpr std::array<std::string_view, 7> rust_words{"struct", "enum", "union", "trait", "impl", "mod", "extern"};
+
+        const std::string code = header_code(header);
+        const std::vector<bool> top = top_level_mask(code);
+
+        // Function keywords win over container keywords in return types (`fn f() -> impl Trait`)
+        std::string_view fn_word = lang_ == SourceLanguage::Rust ? "fn"
+                                 : lang_ == SourceLanguage::Go ? "func"
+                                 : lang_ == SourceLanguage::JavaScript ? "function" : "";
+        if(!fn_word.empty() && find_top_word(code, top, fn_word) != std::string_view::npos) {
+            return true;
+        }
+
+        size_t kw = std::string_view::npos;
+        std::string_view kw_word;
+        auto container_after = [&](const auto& words) {
+            for(auto w : words) {
+                size_t p = find_top_word(code, top, w);
+                if(p != std::string_view::npos && (kw == std::string_view::npos || p > kw)) {
+                    kw = p;
+                    kw_word = w;
+                }
+            }
+        };
+        switch(lang_) {
+            case SourceLanguage::CFamily:    container_after(c_words); break;
+            case SourceLanguage::Go:         container_after(go_words); break;
+            case SourceLanguage::Java:       container_after(java_words); break;
+            case SourceLanguage::JavaScript: container_after(js_words); break;
+            case SourceLanguage::Rust:       container_after(rust_words); break;
+            default: break;
+        }
+        if(kw != std::string_view::npos) {
+            size_t q = skip_blanks(code, kw + kw_word.size());
+            // Attributes between the keyword and the name: __attribute__((x)), alignas(16), [[x]]
+            while(q < code.size()) {
+                size_t w = q;
+                while(w < code.size() && is_ident(code[w])) w++;
+                if(w > q && is_attribute_word(std::string_view(code).substr(q, w - q))) {
+                    q = skip_blanks(code, w);
+                    if(q < code.size() && code[q] == '(') q = skip_blanks(code, group_end(code, q));
+                } else if(code.compare(q, 2, "[[") == 0) {
+                    q = skip_blanks(code, group_end(code, q));
+                } else {
+                    break;
+                }
+            }
+            if(q < code.size() && code[q] == '<') {
+                q = skip_blanks(code, group_end(code, q));   // Rust `impl<T: Fn(u8)> Trait for X`
+            }
+            if(q >= code.size() || code[q] == '{') {
+                return false;   // anonymous or unnamed (extern "C", Go's `struct`)
+            }
+            if(is_ident(code[q])) {
+                const bool elaborated = lang_ == SourceLanguage::CFamily && kw_word != "namespace";
+                if(!elaborated) {
+                    return false;
+                }
+                // C/C++: `struct S {` or `class S : Base {` declares a type, while
+                // `struct S* make(int) {` only names one in a function's return type
+                size_t r = q;
+                while(r < code.size() && (is_ident(code[r]) || code[r] == ':')) {
+                    if(code[r] == ':' && code.compare(r, 2, "::") != 0) break;
+                    r += code[r] == ':' ? 2 : 1;
+                }
+                r = skip_blanks(code, r);
+                if(r < code.size() && code[r] == '<') r = skip_blanks(code, group_end(code, r));
+                if(code.compare(r, 5, "final") == 0) r = skip_blanks(code, r + 5);
+                if(r >= code.size() || code[r] == ':' || code[r] == '{') {
+                    return false;
+                }
+            }
+        }
+
+        // Lambdas and arrow functions
+        for(size_t i = 0; i + 1 < code.size(); i++) {
+            if(!top[i]) continue;
+            if(code.compare(i, 2, "=>") == 0 && lang_ != SourceLanguage::Rust) return true;
+            if(code.compare(i, 2, "->") == 0 && lang_ == SourceLanguage::Java) return true;
+        }
+
+        // A top-level parameter list right after a name (or a C++ lambda's capture list)
+        for(size_t i = 0; i < code.size(); i++) {
+            if(code[i] != '(' || !top[i]) continue;
+            size_t j = i;
+            while(j > 0 && (is_blank(code[j - 1]) || code[j - 1] == '\n')) j--;
+            if(j == 0) continue;
+            if(code[j - 1] == ']') return true;
+            size_t w = j;
+            while(w > 0 && is_ident(code[w - 1])) w--;
+            if(w == j) {
+                // operator==(...), operator<(...)
+                size_t k = j;
+                while(k > 0 && std::strchr("=<>!+-*/%&|^~[]()", code[k - 1]) != nullptr) k--;
+                while(k > 0 && is_blank(code[k - 1])) k--;
+                if(k < j && k >= 8 && find_word(std::string_view(code).substr(0, k), "operator") == k - 8) {
+                    return true;
+                }
+                continue;
+            }
+            if(is_attribute_word(std::string_view(code).substr(w, j - w)) || (w > 0 && code[w - 1] == '@')) {
+                continue;   // attribute or annotation arguments
+            }
+            return true;
+        }
+        return false;
+    }
+
+    std::string_view s_;
+    SourceLanguage lang_;
+    std::string out_;
+    size_t header_start_{0};      // start of the current declaration header in out_
+    size_t line_start_{0};        // start of the current line in out_
+    bool cur_line_comment_{false};
+    bool last_line_comment_{false};
+};
+
+// ----------------------------------------------------------------------------
+// Python (indentation based)
+// ----------------------------------------------------------------------------
+class PythonOutliner {
+public:
+    explicit PythonOutliner(std::string_view src) : s_(src) {
+        out_.reserve(src.size() / 2);
+    }
+
+    std::string run() {
+        bool in_body = false;          // inside a def body being dropped
+        bool body_marked = false;      // "..." already written for this body
+        bool expect_doc = false;       // next deeper statement may be a docstring
+        size_t owner_indent = 0;       // indent of the def/class owning expect_doc/in_body
+        bool first_statement = true;   // module docstring
+        bool blank_after_body = false; // keep one separating blank line after a dropped body
+
+        size_t pos = 0;
+        while(pos < s_.size()) {
+            Line line = next_line(pos);
+            pos = line.end;
+            std::string_view text = s_.substr(line.begin, line.end - line.begin);
+
+            if(line.blank) {
+                if(!in_body) out_.append(text);
+                else blank_after_body = true;
+                continue;
+            }
+            if(in_body) {
+                if(line.indent > owner_indent) {
+                    if(!body_marked) {
+                        if(expect_doc && is_docstring(line)) {
+                            append_doc_summary(line);
+                        }
+                        out_.append(s_.substr(line.begin, line.code - line.begin));
+                        out_ += "...\n";
+                        body_marked = true;
+                    }
+                    continue;
+                }
+                in_body = false;
+                if(blank_after_body) out_ += '\n';
+            }
+            if(expect_doc) {
+                expect_doc = false;
+                if(line.indent > owner_indent && is_docstring(line)) {
+                    append_doc_summary(line);
+                    continue;
+                }
+            }
+            if(first_statement) {
+                first_statement = false;
+                if(is_docstring(line)) {
+                    append_doc_summary(line);
+                    continue;
+                }
+            }
+
+            out_.append(text);
+            std::string_view code = s_.substr(line.code, line.end - line.code);
+            const bool opens_block = last_code_char(line) == ':';
+            const bool is_def = starts_with_word(code, "def") ||
+                (starts_with_word(code, "async") && starts_with_word(trim(code.substr(5)), "def"));
+            if(is_def) {
+                if(opens_block) {
+                    in_body = true;
+                    body_marked = false;
+                    blank_after_body = false;
+                    expect_doc = true;
+                    owner_indent = line.indent;
+                }
+            } else if(starts_with_word(code, "class") && opens_block) {
+                expect_doc = true;
+                owner_indent = line.indent;
+            }
+        }
+        return std::move(out_);
+    }
+
+private:
+    struct Line {
+        size_t begin{0};   // first byte of the physical line
+        size_t code{0};    // first non-blank byte
+        size_t end{0};     // one past the newline ending the logical line
+        size_t indent{0};  // indentation width (tabs to multiples of 8)
+        bool blank{false}; // empty or comment-only
+    };
+
+    size_t string_end(size_t pos) const {
+        const char q = s_[pos];
+        const bool triple = pos + 2 < s_.size() && s_[pos + 1] == q && s_[pos + 2] == q;
+        size_t i = pos + (triple ? 3 : 1);
+        for(; i < s_.size(); i++) {
+            if(s_[i] == '\\') {
+                i++;
+            } else if(s_[i] == q) {
+                if(!triple) return i + 1;
+                if(i + 2 < s_.size() && s_[i + 1] == q && s_[i + 2] == q) return i + 3;
+            } else if(s_[i] == '\n' && !triple) {
+                return i;
+            }
+        }
+        return s_.size();
+    }
+
+    Line next_line(size_t pos) const {
+        Line line;
+        line.begin = pos;
+        size_t p = pos;
+        while(p < s_.size() && is_blank(s_[p])) {
+            line.indent = (s_[p] == '\t') ? (line.indent / 8 + 1) * 8 : line.indent + 1;
+            p++;
+        }
+        line.code = p;
+        if(p >= s_.size() || s_[p] == '\n' || s_[p] == '#') {
+            line.blank = true;
+            size_t nl = s_.find('\n', p);
+            line.end = nl == std::string_view::npos ? s_.size() : nl + 1;
+            return line;
+        }
+        int depth = 0;
+        while(p < s_.size()) {
+            const char c = s_[p];
+            if(c == '"' || c == '\'') {
+                p = string_end(p);
+                continue;
+            }
+            if(c == '#') {
+                while(p < s_.size() && s_[p] != '\n') p++;
+                continue;
+            }
+            if(c == '\\' && p + 1 < s_.size() && s_[p + 1] == '\n') {
+                p += 2;
+                continue;
+            }
+            if(c == '(' || c == '[' || c == '{') depth++;
+            else if((c == ')' || c == ']' || c == '}') && depth > 0) depth--;
+            else if(c == '\n' && depth == 0) {
+                p++;
+                break;
+            }
+            p++;
+        }
+        line.end = p;
+        return line;
+    }
+
+    char last_code_char(const Line& line) const {
+        char last = '\0';
+        for(size_t p = line.code; p < line.end; p++) {
+            const char c = s_[p];
+            if(c == '"' || c == '\'') {
+                p = string_end(p) - 1;
+                last = c;
+            } else if(c == '#') {
+                while(p < line.end && s_[p] != '\n') p++;
+            } else if(!is_blank(c) && c != '\n' && c != '\\') {
+                last = c;
+            }
+        }
+        return last;
+    }
+
+    static bool starts_with_word(std::string_view code, std::string_view word) {
+        return code.substr(0, word.size()) == word &&
+               (code.size() == word.size() || !is_ident(code[word.size()]));
+    }
+
+    /// Length of a string prefix such as r, b, u, f, rb at p (0 if none)
+    size_t prefix_len(size_t p) const {
+        size_t n = 0;
+        while(n < 2 && p + n < s_.size() && std::string_view("rRbBuUfF").find(s_[p + n]) != std::string_view::npos) {
+            n++;
+        }
+        return (p + n < s_.size() && (s_[p + n] == '"' || s_[p + n] == '\'')) ? n : 0;
+    }
+
+    bool is_docstring(const Line& line) const {
+        size_t q = line.code + prefix_len(line.code);
+        if(q >= s_.size() || (s_[q] != '"' && s_[q] != '\'')) {
+            return false;
+        }
+        return all_blank(s_.substr(string_end(q), line.end - string_end(q)));
+    }
+
+    void append_doc_summary(const Line& line) {
+        size_t q = line.code + prefix_len(line.code);
+        size_t lit_end = string_end(q);
+        std::string_view lit = s_.substr(line.code, lit_end - line.code);
+        if(lit.find('\n') == std::string_view::npos) {
+            out_.append(s_.substr(line.begin, line.end - line.begin));
+            return;
+        }
+        const bool triple = q + 2 < s_.size() && s_[q + 1] == s_[q] && s_[q + 2] == s_[q];
+        size_t open_len = (q - line.code) + (triple ? 3 : 1);
+        std::string_view quotes = s_.substr(q, triple ? 3 : 1);
+        std::string_view body = lit.substr(open_len, lit.size() - open_len - quotes.size());
+        std::string_view summary;
+        size_t pos = 0;
+        while(pos <= body.size() && summary.empty()) {
+            size_t nl = body.find('\n', pos);
+            if(nl == std::string_view::npos) nl = body.size();
+            summary = trim(body.substr(pos, nl - pos));
+            pos = nl + 1;
+        }
+        out_.append(s_.substr(line.begin, line.code - line.begin));
+        out_.append(lit.substr(0, open_len));
+        out_.append(summary);
+        out_.append(quotes);
+        out_ += '\n';
+    }
+
+    std::string_view s_;
+    std::string out_;
+};
+
+} // namespace
+
+SourceLanguage detect_language(const std::string& path) {
+    auto ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if(ext == ".c" || ext == ".h" || ext == ".cc" || ext == ".cpp" || ext == ".cxx" ||
+       ext == ".hpp" || ext == ".hh" || ext == ".hxx" || ext == ".ipp" || ext == ".inl") {
+        return SourceLanguage::CFamily;
+    }
+    if(ext == ".go") return SourceLanguage::Go;
+    if(ext == ".java" || ext == ".cs" || ext == ".kt") return SourceLanguage::Java;
+    if(ext == ".js" || ext == ".jsx" || ext == ".mjs" || ext == ".cjs" ||
+       ext == ".ts" || ext == ".tsx" || ext == ".mts" || ext == ".cts") {
+        return SourceLanguage::JavaScript;
+    }
+    if(ext == ".rs") return SourceLanguage::Rust;
+    if(ext == ".py" || ext == ".pyi") return SourceLanguage::Python;
+    return SourceLanguage::Unknown;
+}
+
+std::string outline_source(std::string_view code, SourceLanguage lang) {
+    switch(lang) {
+        case SourceLanguage::Unknown:
+            return std::string(code);
+        case SourceLanguage::Python:
+            return PythonOutliner(code).run();
+        default:
+            return BraceOutliner(code, lang).run();
+    }
+}
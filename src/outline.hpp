@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+enum class SourceLanguage {
+    Unknown,
+    CFamily,     // C, C++, Objective-C headers
+    Go,
+    Java,        // Java, C#, Kotlin
+    JavaScript,  // JavaScript, TypeScript
+    Rust,
+    Python
+};
+
+/**
+ * @brief Guess the language of a file from its extension.
+ * @return SourceLanguage::Unknown if the file shouldn't be outlined
+ */
+SourceLanguage detect_language(const std::string& path);
+
+/**
+ * @brief Reduce source code to its API surface: declarations, signatures,
+ *        class/struct members and doc-comment summaries are kept, function
+ *        bodies are replaced by "{ ... }" (or "..." in Python).
+ *
+ * Uses a single linear pass with a small lexer per language (strings, raw
+ * strings, comments, brace depth or indentation), so it is approximate but
+ * never pathological on large inputs.
+ *
+ * @param code The original file content
+ * @param lang Language from detect_language(); Unknown returns the code unchanged
+ * @return The outlined content
+ */
+std::string outline_source(std::string_view code, SourceLanguage lang);
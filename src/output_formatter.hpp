@@ -18,12 +18,14 @@ struct FormatResult {
  * @param preamble_file Optional file to read as top-level preamble
  * @param scrub_comments If true, remove code comments
  * @param do_token_count If true, compute approximate token count
+ * @param minify_whitespace If true, strip trailing whitespace and collapse blank lines
  * @return FormatResult
  */
 FormatResult format_text(const std::vector<FileInfo>& files,
                          const std::string& preamble_file,
                          bool scrub_comments,
-                         bool do_token_count);
+                         bool do_token_count,
+                         bool minify_whitespace = false);
 
 /**
  * @brief Format the repository contents as JSON (an array of files with path + content).
@@ -32,9 +34,17 @@ FormatResult format_text(const std::vector<FileInfo>& files,
  * @param preamble_file Optional file to read as top-level preamble
  * @param scrub_comments If true, remove code comments
  * @param do_token_count If true, compute approximate token count
+ * @param minify_whitespace If true, strip trailing whitespace and collapse blank lines
  * @return FormatResult
  */
 FormatResult format_json(const std::vector<FileInfo>& files,
                          const std::string& preamble_file,
                          bool scrub_comments,
-                         bool do_token_count);
+                         bool do_token_count,
+                         bool minify_whitespace = false);
+
+/**
+ * @brief Approximate tokens of one file's content as it will be emitted, i.e.
+ *        after comment removal and whitespace minification.
+ */
+long long content_token_count(const FileInfo& file, bool scrub_comments, bool minify_whitespace);
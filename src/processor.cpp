@@ -1,9 +1,20 @@
 #include "processor.hpp"
 #include "repo_scanner.hpp"
 #include "output_formatter.hpp"
+#include "file_reader.hpp"
+#include "git_changes.hpp"
+#include "outline.hpp"
+#include "content_filter.hpp"
+#include "encoding.hpp"
+#include "bm25_index.hpp"
 #include "spdlog/spdlog.h"
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
+#include <functional>
 #include <iostream>  // for std::cin, std::getline
+#include <optional>
+#include <thread>
 
 ProcessResult process_repository(const Arguments& args) {
     ProcessResult result;
@@ -14,9 +25,90 @@ ProcessResult process_repository(const Arguments& args) {
                                                  args.gptignore_file,
                                                  !args.ignore_gitignore);
 
-    // We'll store final files here, either from STDIN or from scan_repository
+    ReadLimits limits;
+    limits.max_bytes = args.max_file_bytes;
+    limits.max_lines = args.max_file_lines;
+    if(auto policy = parse_truncate_policy(args.truncate_policy)) {
+        limits.policy = *policy;
+    } else {
+        result.ok = false;
+        result.error_msg = "Unknown truncate policy: " + args.truncate_policy;
+        return result;
+    }
+
+    auto symlinks = parse_symlink_policy(args.symlinks);
+    if(!symlinks) {
+        result.ok = false;
+        result.error_msg = "Unknown symlink policy: " + args.symlinks;
+        return result;
+    }
+
+    if(args.stdin_file_list && args.changed) {
+        result.ok = false;
+        result.error_msg = "--stdin-file-list and --changed cannot be combined";
+        return result;
+    }
+
+    auto encoding = parse_encoding_policy(args.encoding_policy);
+    if(!encoding) {
+        result.ok = false;
+        result.error_msg = "Unknown encoding policy: " + args.encoding_policy;
+        return result;
+    }
+
+    // Files are converted to UTF-8 as they are read (only their kept ranges,
+    // when limits are set)
+    limits.encoding = *encoding;
+
+    // --grep: files are checked right after they are read, so non-matching
+    // content is dropped before anything else touches it
+    ContentFilter grep;
+    GrepOptions grep_options;
+    grep_options.patterns = args.grep_patterns;
+    grep_options.hunks = args.grep_hunks;
+    grep_options.context = args.grep_context;
+    std::string grep_error;
+    if(!grep.compile(grep_options, grep_error)) {
+        result.ok = false;
+        result.error_msg = grep_error;
+        return result;
+    }
+
+    // --grep has to see whole files, so that line numbers stay right and the
+    // omitted marker can't match; the limits are applied to what it keeps
+    ReadLimits read_limits = limits;
+    if(!grep.empty()) {
+        read_limits.max_bytes = 0;
+        read_limits.max_lines = 0;
+    }
+
+    // Per-file ingestion: convert to UTF-8, then apply --grep and the limits
+    const bool hunks = args.grep_hunks && !grep.empty();
+    std::function<bool(FileInfo&)> keep = [&grep, &limits, hunks, policy = *encoding](FileInfo& f) {
+        if(!normalize_encoding(f.content, policy)) {
+            spdlog::debug("Skipped file that isn't UTF-8: {}", f.relative_path);
+            return false;
+        }
+        if(!grep.apply(f.content)) {
+            spdlog::debug("No match for --grep: {}", f.relative_path);
+            return false;
+        }
+        if(!grep.empty()) {
+            truncate_content(f.content, limits);
+        }
+        f.excerpt = hunks;
+        return true;
+    };
+
+    // Files to emit, as (path shown in the output, path to read); they are only
+    // read once the selection (--query) is done. A plain scan reads them while
+    // walking the tree instead.
+    std::vector<Bm25Source> candidates;
     std::vector<FileInfo> collectedFiles;
 
+    // Patterns compiled once for the STDIN and --changed lists
+    const IgnoreMatcher ignore(args.stdin_file_list || args.changed ? ignore_patterns : std::vector<std::string>{});
+
     // If we are reading file paths from STDIN, skip auto-scan
     if (args.stdin_file_list) {
         spdlog::debug("Reading file paths from STDIN...");
@@ -31,49 +123,166 @@ ProcessResult process_repository(const Arguments& args) {
             }
 
             // If you still want to respect ignore patterns, do so:
-            bool ignored = false;
-            for(const auto &pat : ignore_patterns) {
-                if(matches_pattern(path, pat)) {
-                    spdlog::debug("Ignored file from STDIN: {}", path);
-                    ignored = true;
-                    break;
-                }
-            }
-            if(ignored) {
+            if(ignore.matches(path)) {
+                spdlog::debug("Ignored file from STDIN: {}", path);
                 continue;
             }
 
-            // Open and read the file
-            std::ifstream ifs(path, std::ios::binary);
-            if(!ifs) {
-                spdlog::warn("Could not open file from STDIN: {}", path);
-                continue;
-            }
-            std::string content((std::istreambuf_iterator<char>(ifs)),
-                                 std::istreambuf_iterator<char>());
+            candidates.push_back({path, path});
+        }
+    } else if (args.changed) {
+        // Only files that differ from the index (or from the given revision)
+        spdlog::debug("Looking for changed files...");
+        // Untracked files are skipped if Git ignores them (with Git's own
+        // matching rules), even when .gptignore replaced .gitignore for the
+        // rest of the output.
+        auto changes = find_changed_files(args.repo_path, args.changed_ref,
+                                          args.changed_context, ignore_patterns,
+                                          !args.ignore_gitignore);
+        if (!changes.ok) {
+            result.ok = false;
+            result.error_msg = changes.error_msg;
+            return result;
+        }
+        spdlog::debug("{} changed files, {} context files", changes.changed.size(), changes.context.size());
 
-            FileInfo fi;
-            fi.relative_path = path;  // or just store `path` as-is
-            fi.content = std::move(content);
-            collectedFiles.push_back(std::move(fi));
+        std::filesystem::path base(args.repo_path);
+        for (const auto* list : {&changes.changed, &changes.context}) {
+            for (const auto& rel : *list) {
+                if(ignore.matches(rel)) {
+                    spdlog::debug("Ignored changed file: {}", rel);
+                    continue;
+                }
+                candidates.push_back({rel, base / rel});
+            }
         }
-    } else {
+    } else if (args.query.empty()) {
         // 2. Collect files from filesystem normally
         spdlog::debug("Scanning repository for files...");
-        auto scanResult = scan_repository(args.repo_path, ignore_patterns);
+        auto scanResult = scan_repository(args.repo_path, ignore_patterns, read_limits, *symlinks, keep);
         if (!scanResult.ok) {
             result.ok = false;
             result.error_msg = scanResult.error_msg;
             return result;
         }
         collectedFiles = std::move(scanResult.files);
+    } else {
+        spdlog::debug("Listing repository files...");
+        auto listed = list_repository(args.repo_path, ignore_patterns, *symlinks);
+        if (!listed.ok) {
+            result.ok = false;
+            result.error_msg = listed.error_msg;
+            return result;
+        }
+        std::filesystem::path base(args.repo_path);
+        candidates.reserve(listed.paths.size());
+        for (auto& rel : listed.paths) {
+            auto file = base / rel;
+            candidates.push_back({std::move(rel), std::move(file)});
+        }
+    }
+
+    // Keep only the files relevant to --query, best match first. Contents read
+    // while indexing are kept for the files that can match, so those aren't
+    // read twice.
+    std::vector<std::optional<std::string>> preloaded;
+    if(!args.query.empty()) {
+        spdlog::debug("Ranking {} files for query: {}", candidates.size(), args.query);
+        Bm25Index previous;
+        bool have_previous = !args.index_cache.empty() && previous.load(args.index_cache, *encoding);
+        Bm25Index index;
+        index.retain_contents(args.query);
+        index.build(candidates, have_previous ? &previous : nullptr,
+                    std::max(1u, std::thread::hardware_concurrency()), *encoding);
+        spdlog::debug("Reused {} of {} indexed files", index.reused_docs(), index.docs().size());
+        if(!args.index_cache.empty() && !index.save(args.index_cache)) {
+            spdlog::warn("Could not write index cache: {}", args.index_cache);
+        }
+
+        std::vector<Bm25Source> ranked;
+        for(const auto& [doc, score] : index.search(args.query)) {
+            spdlog::debug("{:.3f} {}", score, candidates[doc].path);
+            ranked.push_back(std::move(candidates[doc]));
+            preloaded.push_back(index.take_content(doc));
+        }
+        if(ranked.empty()) {
+            spdlog::warn("No files match the query: {}", args.query);
+        }
+        candidates = std::move(ranked);
+    }
+
+    // Read the selected files (only the kept ranges, if limits are set), unless
+    // the index already did
+    collectedFiles.reserve(collectedFiles.size() + candidates.size());
+    for(size_t i = 0; i < candidates.size(); i++) {
+        auto& c = candidates[i];
+        std::string content;
+        bool skipped = false;
+        if(i < preloaded.size() && preloaded[i]) {
+            content = std::move(*preloaded[i]);
+            truncate_content(content, read_limits);
+        } else if(!read_file_limited(c.file, read_limits, content, &skipped)) {
+            spdlog::warn("Could not open file: {}", c.path);
+            continue;
+        }
+        if(skipped) {
+            spdlog::debug("Skipped file that isn't UTF-8: {}", c.path);
+            continue;
+        }
+
+        FileInfo fi;
+        fi.relative_path = std::move(c.path);
+        fi.content = std::move(content);
+        if(!keep(fi)) {
+            continue;
+        }
+        collectedFiles.push_back(std::move(fi));
+    }
+
+    // Reduce source files to their API surface, except those kept in full
+    // (grep hunks are already excerpts and are left alone)
+    if(args.outline && !hunks) {
+        spdlog::debug("Outlining source files...");
+        for(auto& f : collectedFiles) {
+            bool full = false;
+            for(const auto& pat : args.full_globs) {
+                if(matches_pattern(f.relative_path, pat)) {
+                    full = true;
+                    break;
+                }
+            }
+            auto lang = detect_language(f.relative_path);
+            if(!full && lang != SourceLanguage::Unknown) {
+                f.content = outline_source(f.content, lang);
+            }
+        }
+    }
+
+    // Drop files that would exceed the token budget; files are in priority
+    // order, so smaller files further down may still fit.
+    if(args.token_budget > 0) {
+        std::uint64_t used = 0;
+        std::vector<FileInfo> kept;
+        for(auto& f : collectedFiles) {
+            auto tokens = static_cast<std::uint64_t>(
+                content_token_count(f, args.scrub_comments, args.minify_whitespace));
+            if(used + tokens > args.token_budget) {
+                spdlog::debug("Over token budget, skipping: {} (~{} tokens)", f.relative_path, tokens);
+                continue;
+            }
+            used += tokens;
+            kept.push_back(std::move(f));
+        }
+        collectedFiles = std::move(kept);
     }
 
-    // 3. Format output (JSON or text), possibly scrub comments
+    // 3. Format output (JSON or text), possibly scrub comments / minify whitespace
     spdlog::debug("Formatting output...");
     auto out = (args.output_json)
-        ? format_json(collectedFiles, args.preamble_file, args.scrub_comments, args.estimate)
-        : format_text(collectedFiles, args.preamble_file, args.scrub_comments, args.estimate);
+        ? format_json(collectedFiles, args.preamble_file, args.scrub_comments, args.estimate,
+                      args.minify_whitespace)
+        : format_text(collectedFiles, args.preamble_file, args.scrub_comments, args.estimate,
+                      args.minify_whitespace);
 
     if(!out.ok) {
         result.ok = false;
@@ -82,7 +291,7 @@ ProcessResult process_repository(const Arguments& args) {
     }
 
     result.ok = true;
-    result.output = out.data;
+    result.output = std::move(out.data);
     result.token_estimate = out.tokens;
     return result;
 }
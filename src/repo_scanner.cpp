@@ -1,4 +1,5 @@
 #include "repo_scanner.hpp"
+#include "dir_walker.hpp"
 #include "spdlog/spdlog.h"
 #include <filesystem>
 #include <fstream>
@@ -10,15 +11,10 @@
 
 namespace fs = std::filesystem;
 
-/**
- * @brief Simple glob-like matching. For more advanced logic, integrate a real glob library.
- */
-bool matches_pattern(const std::string& text, const std::string& pattern) {
-    // Very naive approach:
-    // 1) Replace "**" with ".*"
-    // 2) Replace "*" with "[^/]*"
-    // 3) Then do a full regex match
+namespace {
 
+/// Anchored regex for a glob: "**" matches anything, "*" anything but '/'
+std::string glob_to_regex(const std::string& pattern) {
     std::string re;
     re.reserve(pattern.size() * 2);
     for(size_t i=0; i<pattern.size(); i++) {
@@ -37,21 +33,42 @@ bool matches_pattern(const std::string& text, const std::string& pattern) {
             re.push_back(pattern[i]);
         }
     }
-    re = "^" + re + "$";
-
-    try {
-        std::regex rgx(re, std::regex::ECMAScript | std::regex::icase);
-        return std::regex_match(text, rgx);
-    } catch(...) {
-        // Fallback: if invalid pattern, do a simple substring check
-        if(text.find(pattern) != std::string::npos) {
+    return "^" + re + "$";
+}
+
+} // namespace
+
+/**
+ * @brief Simple glob-like matching. For more advanced logic, integrate a real glob library.
+ */
+bool matches_pattern(const std::string& text, const std::string& pattern) {
+    return IgnoreMatcher({pattern}).matches(text);
+}
+
+IgnoreMatcher::IgnoreMatcher(const std::vector<std::string>& patterns) {
+    compiled_.reserve(patterns.size());
+    for(const auto& pat : patterns) {
+        Compiled c;
+        try {
+            c.re = std::regex(glob_to_regex(pat), std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+        } catch(...) {
+            // Fallback: if invalid pattern, do a simple substring check
+            c.substring = pat;
+        }
+        compiled_.push_back(std::move(c));
+    }
+}
+
+bool IgnoreMatcher::matches(const std::string& text) const {
+    for(const auto& c : compiled_) {
+        if(c.re ? std::regex_match(text, *c.re) : text.find(c.substring) != std::string::npos) {
             return true;
         }
-        return false;
     }
+    return false;
 }
 
-static std::vector<std::string> parse_ignore_file(const fs::path& path) {
+std::vector<std::string> parse_ignore_file(const fs::path& path) {
     std::vector<std::string> patterns;
     if(!fs::exists(path)) return patterns;
 
@@ -114,54 +131,123 @@ std::vector<std::string> build_ignore_patterns(const std::string& repo_path,
     return result;
 }
 
-ScanResult scan_repository(const std::string& repo_path, const std::vector<std::string>& ignore_patterns) {
-    ScanResult sr;
-    fs::path base(repo_path);
+/**
+ * @brief Directories whose whole content is ignored ("dir/" followed by "**"), so the
+ *        walk doesn't need to descend into them at all (e.g. .git).
+ */
+static bool is_ignored_dir(std::string_view dir, const IgnoreMatcher& dir_patterns) {
+    if(dir_patterns.matches(std::string(dir))) {
+        spdlog::debug("Ignored directory: {}", dir);
+        return true;
+    }
+    return false;
+}
+
+static bool is_ignored_file(const std::string& rel, const IgnoreMatcher& ignore) {
+    if(ignore.matches(rel)) {
+        spdlog::debug("Ignored file: {}", rel);
+        return true;
+    }
+    return false;
+}
 
+/// The "dir" part of every "dir/**" pattern
+static IgnoreMatcher dir_matcher(const std::vector<std::string>& ignore_patterns) {
+    std::vector<std::string> dirs;
+    for(const auto& pat : ignore_patterns) {
+        if(pat.size() > 3 && pat.compare(pat.size() - 3, 3, "/**") == 0) {
+            dirs.push_back(pat.substr(0, pat.size() - 3));
+        }
+    }
+    return IgnoreMatcher(dirs);
+}
+
+static bool check_repository_path(const std::string& repo_path, std::string& error_msg) {
+    fs::path base(repo_path);
     if(!fs::exists(base)) {
-        sr.ok = false;
-        sr.error_msg = "Repository path does not exist: " + repo_path;
-        return sr;
+        error_msg = "Repository path does not exist: " + repo_path;
+        return false;
     }
     if(!fs::is_directory(base)) {
-        sr.ok = false;
-        sr.error_msg = "Path is not a directory: " + repo_path;
-        return sr;
+        error_msg = "Path is not a directory: " + repo_path;
+        return false;
+    }
+    return true;
+}
+
+ListResult list_repository(const std::string& repo_path,
+                           const std::vector<std::string>& ignore_patterns,
+                           SymlinkPolicy symlinks) {
+    ListResult lr;
+    if(!check_repository_path(repo_path, lr.error_msg)) {
+        lr.ok = false;
+        return lr;
     }
 
-    try {
-        for(const auto& entry : fs::recursive_directory_iterator(base)) {
-            if(entry.is_regular_file()) {
-                auto rel = fs::relative(entry.path(), base).generic_string();
-                bool ignored = false;
-                for(const auto& pat : ignore_patterns) {
-                    if(matches_pattern(rel, pat)) {
-                        spdlog::debug("Ignored file: {}", rel);
-                        ignored = true;
-                        break;
-                    }
-                }
-                if(ignored) continue;
-
-                std::ifstream ifs(entry.path(), std::ios::binary);
-                if(!ifs) {
-                    spdlog::warn("Could not open file: {}", rel);
-                    continue;
-                }
-                std::string content((std::istreambuf_iterator<char>(ifs)),
-                                     std::istreambuf_iterator<char>());
-
-                FileInfo fi;
-                fi.relative_path = rel;
-                fi.content = std::move(content);
-                sr.files.push_back(std::move(fi));
+    const IgnoreMatcher ignore(ignore_patterns);
+    const IgnoreMatcher ignored_dirs = dir_matcher(ignore_patterns);
+    std::string rel;
+    auto walked = walk_directory(
+        repo_path, symlinks,
+        [&](std::string_view dir) { return is_ignored_dir(dir, ignored_dirs); },
+        [&](const WalkEntry& entry) {
+            rel.assign(entry.path);
+            if(!is_ignored_file(rel, ignore)) {
+                lr.paths.push_back(rel);
             }
-        }
-    } catch(const std::exception& e) {
+        });
+    if(!walked.ok) {
+        lr.ok = false;
+        lr.error_msg = walked.error_msg;
+    }
+    return lr;
+}
+
+ScanResult scan_repository(const std::string& repo_path,
+                           const std::vector<std::string>& ignore_patterns,
+                           const ReadLimits& limits,
+                           SymlinkPolicy symlinks,
+                           const std::function<bool(FileInfo&)>& keep) {
+    ScanResult sr;
+    if(!check_repository_path(repo_path, sr.error_msg)) {
         sr.ok = false;
-        sr.error_msg = e.what();
         return sr;
     }
 
+    // Files are read as they are found, relative to their parent directory
+    const IgnoreMatcher ignore(ignore_patterns);
+    const IgnoreMatcher ignored_dirs = dir_matcher(ignore_patterns);
+    std::string rel;
+    auto walked = walk_directory(
+        repo_path, symlinks,
+        [&](std::string_view dir) { return is_ignored_dir(dir, ignored_dirs); },
+        [&](const WalkEntry& entry) {
+            rel.assign(entry.path);
+            if(is_ignored_file(rel, ignore)) {
+                return;
+            }
+            std::string content;
+            bool skipped = false;
+            if(!read_walk_entry(entry, limits, content, &skipped)) {
+                spdlog::warn("Could not open file: {}", rel);
+                return;
+            }
+            if(skipped) {
+                spdlog::debug("Skipped file that isn't UTF-8: {}", rel);
+                return;
+            }
+
+            FileInfo fi;
+            fi.relative_path = rel;
+            fi.content = std::move(content);
+            if(keep && !keep(fi)) {
+                return;
+            }
+            sr.files.push_back(std::move(fi));
+        });
+    if(!walked.ok) {
+        sr.ok = false;
+        sr.error_msg = walked.error_msg;
+    }
     return sr;
 }
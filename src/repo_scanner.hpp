@@ -1,12 +1,18 @@
 #pragma once
 
+#include "dir_walker.hpp"
+#include "file_reader.hpp"
+#include <filesystem>
+#include <functional>
 #include <string>
 #include <vector>
 #include <optional>
+#include <regex>
 
 struct FileInfo {
     std::string relative_path;
     std::string content;
+    bool excerpt{false};   // content is --grep hunks (numbered lines and "--" separators)
 };
 
 struct ScanResult {
@@ -15,6 +21,19 @@ struct ScanResult {
     std::vector<FileInfo> files;
 };
 
+struct ListResult {
+    bool ok{true};
+    std::string error_msg;
+    std::vector<std::string> paths;   // relative to the repository, '/'-separated
+};
+
+/**
+ * @brief Read glob-like patterns from a .gitignore/.gptignore style file
+ *        (comments and blank lines skipped, and "dir/" gets "**" appended).
+ * @return the patterns, or an empty vector if the file doesn't exist
+ */
+std::vector<std::string> parse_ignore_file(const std::filesystem::path& path);
+
 /**
  * @brief Generate combined ignore patterns from .gptignore (if any) and optionally .gitignore.
  *
@@ -27,13 +46,32 @@ std::vector<std::string> build_ignore_patterns(const std::string& repo_path,
                                                const std::string& gptignore_path,
                                                bool use_gitignore);
 
+/**
+ * @brief Recursively list the repo's files without reading them, ignoring patterns in ignore list.
+ * @param repo_path The root path of the repository
+ * @param ignore_patterns Patterns to exclude
+ * @param symlinks How symbolic links are handled
+ * @return ListResult with the relative paths of the kept files
+ */
+ListResult list_repository(const std::string& repo_path,
+                           const std::vector<std::string>& ignore_patterns,
+                           SymlinkPolicy symlinks = SymlinkPolicy::Files);
+
 /**
  * @brief Recursively scan the repo's filesystem for files, ignoring .git and patterns in ignore list.
  * @param repo_path The root path of the repository
  * @param ignore_patterns Patterns to exclude
+ * @param limits Per-file size limits (files over the limit are truncated, see read_file_limited)
+ * @param symlinks How symbolic links are handled
+ * @param keep If set, called on each file right after it is read (it may change
+ *             the content); files for which it returns false are dropped
  * @return ScanResult
  */
-ScanResult scan_repository(const std::string& repo_path, const std::vector<std::string>& ignore_patterns);
+ScanResult scan_repository(const std::string& repo_path,
+                           const std::vector<std::string>& ignore_patterns,
+                           const ReadLimits& limits,
+                           SymlinkPolicy symlinks = SymlinkPolicy::Files,
+                           const std::function<bool(FileInfo&)>& keep = nullptr);
 
 /**
  * @brief Glob-like check if a given path matches a given ignore pattern (e.g. *.log, dir/**, etc.)
@@ -42,3 +80,22 @@ ScanResult scan_repository(const std::string& repo_path, const std::vector<std::
  * @return true if matches, false otherwise
  */
 bool matches_pattern(const std::string& text, const std::string& pattern);
+
+/**
+ * @brief A set of ignore patterns compiled once, for checking many paths
+ *        (same matching as matches_pattern).
+ */
+class IgnoreMatcher {
+public:
+    explicit IgnoreMatcher(const std::vector<std::string>& patterns);
+
+    /// @return true if text matches any of the patterns
+    bool matches(const std::string& text) const;
+
+private:
+    struct Compiled {
+        std::optional<std::regex> re;
+        std::string substring;   // used for patterns that don't compile
+    };
+    std::vector<Compiled> compiled_;
+};
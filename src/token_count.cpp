@@ -1,15 +1,10 @@
 #include "token_count.hpp"
-#include <sstream>
 #include <string>
 
 long long approximate_token_count(const std::string& text) {
-    // Quick approach: count whitespace-delimited words
+    // Count whitespace-delimited words in a single pass.
     // Each word is approx. 1 token (rough approximation).
-    long long count = 0;
-    std::istringstream iss(text);
-    std::string word;
-    while(iss >> word) {
-        count++;
-    }
-    return count;
+    TokenCounter counter;
+    counter.feed(text);
+    return counter.count;
 }
@@ -1,6 +1,36 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+
+/**
+ * @brief Incremental whitespace-delimited word counter.
+ *        Bytes can be fed in any number of pieces; a word split across two
+ *        feeds is only counted once. Whitespace matches the "C" locale isspace().
+ */
+struct TokenCounter {
+    long long count{0};
+    bool in_word{false};
+
+    static constexpr bool is_space(char c) {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    void feed(char c) {
+        if(is_space(c)) {
+            in_word = false;
+        } else if(!in_word) {
+            in_word = true;
+            count++;
+        }
+    }
+
+    void feed(std::string_view text) {
+        for(char c : text) {
+            feed(c);
+        }
+    }
+};
 
 /**
  * @brief Very rough token estimate by splitting on whitespace.
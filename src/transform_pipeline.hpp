@@ -0,0 +1,413 @@
+#pragma once
+
+#include "token_count.hpp"
+#include <string>
+#include <string_view>
+
+/**
+ * Per-file transform pipeline.
+ *
+ * Each stage is a class template with an enabled primary template and a
+ * pass-through specialization for the disabled case. Stages push bytes to the
+ * next stage, so the whole chain (comment removal -> whitespace minification ->
+ * escaping -> output/token counting) runs as one pass over a file's bytes with
+ * no intermediate strings. The chain is fixed at compile time; the runtime
+ * options only pick which instantiation to use, once per output.
+ */
+
+enum class EscapeMode {
+    Raw,   // plain text output, bytes are copied as-is
+    Json   // JSON string body
+};
+
+// ----------------------------------------------------------------------------
+// Sink: appends to the output string and optionally counts tokens.
+// ----------------------------------------------------------------------------
+template <bool CountTokens>
+struct OutputSink {
+    std::string& out;
+    TokenCounter& counter;
+
+    void put(char c) {
+        out.push_back(c);
+        if constexpr (CountTokens) {
+            counter.feed(c);
+        }
+    }
+    void put(std::string_view s) {
+        out.append(s);
+        if constexpr (CountTokens) {
+            counter.feed(s);
+        }
+    }
+    void finish() {}
+};
+
+// ----------------------------------------------------------------------------
+// Escape stage
+// ----------------------------------------------------------------------------
+template <EscapeMode Mode, class Next>
+struct EscapeStage;
+
+template <class Next>
+struct EscapeStage<EscapeMode::Raw, Next> {
+    Next& next;
+
+    void put(char c) { next.put(c); }
+    void put(std::string_view s) { next.put(s); }
+    void finish() { next.finish(); }
+};
+
+template <class Next>
+struct EscapeStage<EscapeMode::Json, Next> {
+    Next& next;
+
+    static constexpr bool needs_escape(char c) {
+        return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+    }
+
+    void put(char c) {
+        if(!needs_escape(c)) {
+            next.put(c);
+            return;
+        }
+        switch(c) {
+            case '"':  next.put(std::string_view("\\\"")); break;
+            case '\\': next.put(std::string_view("\\\\")); break;
+            case '\n': next.put(std::string_view("\\n")); break;
+            case '\r': next.put(std::string_view("\\r")); break;
+            case '\t': next.put(std::string_view("\\t")); break;
+            case '\b': next.put(std::string_view("\\b")); break;
+            case '\f': next.put(std::string_view("\\f")); break;
+            default: {
+                static constexpr char hex[] = "0123456789abcdef";
+                const char esc[6] = {'\\', 'u', '0', '0',
+                                     hex[(c >> 4) & 0x0f], hex[c & 0x0f]};
+                next.put(std::string_view(esc, sizeof(esc)));
+                break;
+            }
+        }
+    }
+
+    void put(std::string_view s) {
+        // Forward runs of bytes that need no escaping in one piece.
+        size_t start = 0;
+        for(size_t i = 0; i < s.size(); i++) {
+            if(needs_escape(s[i])) {
+                if(i > start) next.put(s.substr(start, i - start));
+                put(s[i]);
+                start = i + 1;
+            }
+        }
+        if(start < s.size()) next.put(s.substr(start));
+    }
+
+    void finish() { next.finish(); }
+};
+
+// ----------------------------------------------------------------------------
+// Whitespace minification stage: strips trailing whitespace from each line,
+// drops leading/trailing blank lines and collapses runs of blank lines into one.
+// Indentation is kept, since it is significant in some languages.
+// ----------------------------------------------------------------------------
+template <bool Enabled, class Next>
+struct MinifyStage {
+    Next& next;
+    std::string pending_ws{};    // whitespace not yet known to be followed by content
+    bool line_has_content{false};
+    bool emitted_any{false};
+    bool pending_blank{false};
+
+    static constexpr bool is_blank(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    void put(char c) {
+        if(c == '\n') {
+            if(line_has_content) {
+                next.put('\n');
+            } else if(emitted_any) {
+                pending_blank = true;
+            }
+            pending_ws.clear();
+            line_has_content = false;
+        } else if(is_blank(c)) {
+            pending_ws.push_back(c);
+        } else {
+            if(!line_has_content && pending_blank) {
+                next.put('\n');
+                pending_blank = false;
+            }
+            if(!pending_ws.empty()) {
+                next.put(std::string_view(pending_ws));
+                pending_ws.clear();
+            }
+            next.put(c);
+            line_has_content = true;
+            emitted_any = true;
+        }
+    }
+
+    void put(std::string_view s) {
+        for(char c : s) put(c);
+    }
+
+    void finish() {
+        pending_ws.clear();
+        line_has_content = false;
+        emitted_any = false;
+        pending_blank = false;
+        next.finish();
+    }
+};
+
+template <class Next>
+struct MinifyStage<false, Next> {
+    Next& next;
+
+    void put(char c) { next.put(c); }
+    void put(std::string_view s) { next.put(s); }
+    void finish() { next.finish(); }
+};
+
+// ----------------------------------------------------------------------------
+// Comment removal stage.
+//
+// 1) Block comments /* ... */, <!-- ... --> and // line comments are removed
+//    (an unterminated block comment runs to the end of the file).
+// 2) On what remains, lines whose first non-blank text is #, --, ; or % are
+//    dropped entirely, and every kept line is terminated with '\n'.
+//
+// This is not language-perfect but helps reduce tokens in code-like files.
+// ----------------------------------------------------------------------------
+template <bool Enabled, class Next>
+struct CommentStage {
+    enum class Block { Normal, Slash, LineComment, CBlock, CBlockStar,
+                       Lt, LtBang, LtBangDash, Html, HtmlDash, HtmlDashDash };
+    enum class Line { Start, Dash, Body, Drop };
+
+    Next& next;
+    Block block{Block::Normal};
+    Line line{Line::Start};
+    std::string leading_ws{};    // blank prefix of the current line, held until we know it is kept
+
+    void put(char c) {
+        switch(block) {
+            case Block::Normal:
+                if(c == '/') block = Block::Slash;
+                else if(c == '<') block = Block::Lt;
+                else emit(c);
+                return;
+            case Block::Slash:
+                if(c == '*') { block = Block::CBlock; return; }
+                if(c == '/') { block = Block::LineComment; return; }
+                return resume("/", c);
+            case Block::LineComment:
+                if(c == '\n') { block = Block::Normal; emit(c); }
+                return;
+            case Block::CBlock:
+                if(c == '*') block = Block::CBlockStar;
+                return;
+            case Block::CBlockStar:
+                if(c == '/') block = Block::Normal;
+                else if(c != '*') block = Block::CBlock;
+                return;
+            case Block::Lt:
+                if(c == '!') { block = Block::LtBang; return; }
+                return resume("<", c);
+            case Block::LtBang:
+                if(c == '-') { block = Block::LtBangDash; return; }
+                return resume("<!", c);
+            case Block::LtBangDash:
+                if(c == '-') { block = Block::Html; return; }
+                return resume("<!-", c);
+            case Block::Html:
+                if(c == '-') block = Block::HtmlDash;
+                return;
+            case Block::HtmlDash:
+                block = (c == '-') ? Block::HtmlDashDash : Block::Html;
+                return;
+            case Block::HtmlDashDash:
+                if(c == '>') block = Block::Normal;
+                else if(c != '-') block = Block::Html;
+                return;
+        }
+    }
+
+    void put(std::string_view s) {
+        for(char c : s) put(c);
+    }
+
+    void finish() {
+        // Flush a partially matched opener ("/", "<", "<!", "<!-").
+        switch(block) {
+            case Block::Slash:      emit(std::string_view("/")); break;
+            case Block::Lt:         emit(std::string_view("<")); break;
+            case Block::LtBang:     emit(std::string_view("<!")); break;
+            case Block::LtBangDash: emit(std::string_view("<!-")); break;
+            default: break;
+        }
+        // Terminate the last line like std::getline + "\n" would.
+        switch(line) {
+            case Line::Start:
+                if(!leading_ws.empty()) {
+                    next.put(std::string_view(leading_ws));
+                    next.put('\n');
+                }
+                break;
+            case Line::Dash:
+                next.put(std::string_view(leading_ws));
+                next.put(std::string_view("-\n"));
+                break;
+            case Line::Body:
+                next.put('\n');
+                break;
+            case Line::Drop:
+                break;
+        }
+        block = Block::Normal;
+        line = Line::Start;
+        leading_ws.clear();
+        next.finish();
+    }
+
+private:
+    // A partial opener turned out not to be a comment: emit it and re-scan c.
+    void resume(std::string_view held, char c) {
+        block = Block::Normal;
+        emit(held);
+        put(c);
+    }
+
+    void emit(std::string_view s) {
+        for(char c : s) emit(c);
+    }
+
+    // Line filter over the block-stripped stream.
+    void emit(char c) {
+        switch(line) {
+            case Line::Start:
+                if(c == '\n') {
+                    next.put(std::string_view(leading_ws));
+                    next.put('\n');
+                    leading_ws.clear();
+                } else if(TokenCounter::is_space(c)) {
+                    leading_ws.push_back(c);
+                } else if(c == '#' || c == ';' || c == '%') {
+                    line = Line::Drop;
+                } else if(c == '-') {
+                    line = Line::Dash;
+                } else {
+                    start_body();
+                    next.put(c);
+                }
+                return;
+            case Line::Dash:
+                if(c == '-') {
+                    line = Line::Drop;
+                    return;
+                }
+                start_body();
+                next.put('-');
+                [[fallthrough]];
+            case Line::Body:
+                next.put(c);
+                if(c == '\n') line = Line::Start;
+                return;
+            case Line::Drop:
+                if(c == '\n') {
+                    line = Line::Start;
+                    leading_ws.clear();
+                }
+                return;
+        }
+    }
+
+    void start_body() {
+        line = Line::Body;
+        if(!leading_ws.empty()) {
+            next.put(std::string_view(leading_ws));
+            leading_ws.clear();
+        }
+    }
+};
+
+template <class Next>
+struct CommentStage<false, Next> {
+    Next& next;
+
+    void put(char c) { next.put(c); }
+    void put(std::string_view s) { next.put(s); }
+    void finish() { next.finish(); }
+};
+
+// ----------------------------------------------------------------------------
+// The fused pipeline
+// ----------------------------------------------------------------------------
+template <bool Scrub, bool Minify, EscapeMode Escape, bool CountTokens>
+class TransformPipeline {
+public:
+    using Sink = OutputSink<CountTokens>;
+    using Escaper = EscapeStage<Escape, Sink>;
+    using Minifier = MinifyStage<Minify, Escaper>;
+    using Scrubber = CommentStage<Scrub, Minifier>;
+
+    TransformPipeline(std::string& out, TokenCounter& counter)
+        : sink_{out, counter}, escape_{sink_}, minify_{escape_}, scrub_{minify_} {}
+
+    TransformPipeline(const TransformPipeline&) = delete;
+    TransformPipeline& operator=(const TransformPipeline&) = delete;
+
+    /// Run a file's content through every enabled stage.
+    void content(std::string_view s) {
+        scrub_.put(s);
+        scrub_.finish();
+    }
+
+    /// Like content(), without comment removal: for grep hunks, whose "--"
+    /// separators and line number prefixes must survive.
+    void excerpt(std::string_view s) {
+        minify_.put(s);
+        minify_.finish();
+    }
+
+    /// Escape only (paths, preamble): no comment removal or minification.
+    void escaped(std::string_view s) { escape_.put(s); }
+
+    /// Structural output (delimiters, JSON punctuation): written verbatim.
+    void raw(std::string_view s) { sink_.put(s); }
+
+private:
+    Sink sink_;
+    Escaper escape_;
+    Minifier minify_;
+    Scrubber scrub_;
+};
+
+struct TransformOptions {
+    bool scrub_comments{false};
+    bool minify_whitespace{false};
+    bool count_tokens{false};
+};
+
+/**
+ * @brief Pick the TransformPipeline instantiation matching the runtime options
+ *        and call fn(pipeline) with it.
+ */
+template <EscapeMode Escape, class Fn>
+void with_pipeline(const TransformOptions& opts, std::string& out, TokenCounter& counter, Fn&& fn) {
+    auto run = [&]<bool S, bool M, bool C>() {
+        TransformPipeline<S, M, Escape, C> p(out, counter);
+        fn(p);
+    };
+    auto with_count = [&]<bool S, bool M>() {
+        if(opts.count_tokens) run.template operator()<S, M, true>();
+        else run.template operator()<S, M, false>();
+    };
+    auto with_minify = [&]<bool S>() {
+        if(opts.minify_whitespace) with_count.template operator()<S, true>();
+        else with_count.template operator()<S, false>();
+    };
+    if(opts.scrub_comments) with_minify.template operator()<true>();
+    else with_minify.template operator()<false>();
+}
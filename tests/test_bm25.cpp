@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include "bm25_index.hpp"
+#include "test_util.hpp"
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+class Bm25Test : public TempDirTest {
+protected:
+    Bm25Source write_temp(const std::string& name, const std::string& content) {
+        write_file(dir / name, content);
+        return {name, dir / name};
+    }
+};
+
+TEST_F(Bm25Test, TermsSplitIdentifiers) {
+    auto terms = bm25_terms("parseHTTPHeader max_retry_count 42 v2");
+    std::vector<std::string> expected = {"parsehttpheader", "parse", "http", "header",
+                                         "max_retry_count", "max", "retry", "count", "v2"};
+    EXPECT_EQ(terms, expected);
+}
+
+TEST_F(Bm25Test, RanksRelevantFilesFirst) {
+    std::vector<Bm25Source> sources = {
+        write_temp("readme.txt", "This project converts repositories to prompts.\n"),
+        write_temp("http_client.cpp", "void HttpClient::retry() { retry_count++; timeout(); }\n"),
+        write_temp("math.cpp", "int add(int a, int b) { return a + b; }\n"),
+        write_temp("net.cpp", "// a single retry\nvoid send();\n"),
+    };
+
+    Bm25Index index;
+    index.build(sources, nullptr, 2);
+    auto ranked = index.search("http retry");
+    ASSERT_EQ(ranked.size(), 2u);
+    EXPECT_EQ(index.docs()[ranked[0].first].path, "http_client.cpp");
+    EXPECT_EQ(index.docs()[ranked[1].first].path, "net.cpp");
+    EXPECT_GT(ranked[0].second, ranked[1].second);
+    EXPECT_TRUE(index.search("nonexistent").empty());
+}
+
+TEST_F(Bm25Test, CacheReusesUnchangedFiles) {
+    std::vector<Bm25Source> sources = {
+        write_temp("a.txt", "alpha beta\n"),
+        write_temp("b.txt", "gamma delta\n"),
+    };
+    Bm25Index first;
+    first.build(sources, nullptr, 1);
+    ASSERT_TRUE(first.save(dir / "index.bin"));
+
+    // b.txt changes size, c.txt is new
+    write_temp("b.txt", "gamma epsilon epsilon\n");
+    sources.push_back(write_temp("c.txt", "alpha zeta\n"));
+
+    Bm25Index previous;
+    ASSERT_TRUE(previous.load(dir / "index.bin"));
+    Bm25Index second;
+    second.build(sources, &previous, 4);
+    EXPECT_EQ(second.reused_docs(), 1u);
+
+    auto ranked = second.search("epsilon");
+    ASSERT_EQ(ranked.size(), 1u);
+    EXPECT_EQ(second.docs()[ranked[0].first].path, "b.txt");
+    EXPECT_TRUE(second.search("delta").empty());
+    EXPECT_EQ(second.search("alpha").size(), 2u);
+
+    EXPECT_FALSE(previous.load(dir / "a.txt"));
+
+    // Contents decoded with another policy aren't reused
+    Bm25Index skipped;
+    skipped.build(sources, nullptr, 1, EncodingPolicy::Skip);
+    ASSERT_TRUE(skipped.save(dir / "index.bin"));
+    EXPECT_FALSE(previous.load(dir / "index.bin", EncodingPolicy::Transcode));
+    EXPECT_TRUE(previous.load(dir / "index.bin", EncodingPolicy::Skip));
+}
+
+TEST_F(Bm25Test, RetainsContentsOfMatchingFiles) {
+    std::vector<Bm25Source> sources = {
+        write_temp("a.txt", "retry loop\n"),
+        write_temp("b.txt", "unrelated\n"),
+    };
+    Bm25Index index;
+    index.retain_contents("retry");
+    index.build(sources, nullptr, 2);
+    auto a = index.take_content(0);
+    ASSERT_TRUE(a.has_value());
+    EXPECT_EQ(*a, "retry loop\n");
+    EXPECT_FALSE(index.take_content(0).has_value());   // moved out
+    EXPECT_FALSE(index.take_content(1).has_value());
+}
+
+TEST_F(Bm25Test, IndexesUtf16Content) {
+    std::string utf16 = "\xFF\xFE";
+    for(char c : std::string("void retry_loop();\n")) {
+        utf16.push_back(c);
+        utf16.push_back('\0');
+    }
+    std::vector<Bm25Source> sources = {write_temp("wide.cpp", utf16)};
+
+    Bm25Index index;
+    index.build(sources, nullptr, 1, EncodingPolicy::Transcode);
+    EXPECT_EQ(index.search("retry").size(), 1u);
+
+    Bm25Index skipped;
+    skipped.build(sources, nullptr, 1, EncodingPolicy::Skip);
+    EXPECT_TRUE(skipped.search("retry").empty());
+    EXPECT_EQ(skipped.search("wide").size(), 1u);
+}
+
+TEST_F(Bm25Test, CorruptCacheIsRejected) {
+    auto write_cache = [&](const std::string& body) {
+        std::ofstream ofs(dir / "index.bin", std::ios::binary);
+        // Tokenizer version 1, transcode policy
+        ofs << "G2PBM252" << std::string("\1\0\0\0\0\0\0\0", 8) << body;
+    };
+    Bm25Index index;
+
+    // ~4 billion documents in a 12-byte file
+    write_cache(std::string("\xFF\xFF\xFF\xFF", 4));
+    EXPECT_FALSE(index.load(dir / "index.bin"));
+
+    // No documents, ~4 billion terms
+    write_cache(std::string("\0\0\0\0\xFF\xFF\xFF\xFF", 8));
+    EXPECT_FALSE(index.load(dir / "index.bin"));
+
+    // Tokenizer version 2
+    {
+        std::ofstream ofs(dir / "index.bin", std::ios::binary);
+        ofs << "G2PBM252" << std::string("\2\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0", 16);
+    }
+    EXPECT_FALSE(index.load(dir / "index.bin"));
+
+    // One term claiming ~4 billion postings
+    write_cache(std::string("\0\0\0\0\1\0\0\0\1\0\0\0x\xFF\xFF\xFF\xFF", 17));
+    EXPECT_FALSE(index.load(dir / "index.bin"));
+    EXPECT_TRUE(index.docs().empty());
+}
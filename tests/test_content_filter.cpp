@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "content_filter.hpp"
+#include <random>
+
+static bool apply_filter(const GrepOptions& options, std::string& content) {
+    ContentFilter filter;
+    std::string error;
+    EXPECT_TRUE(filter.compile(options, error)) << error;
+    return filter.apply(content);
+}
+
+TEST(ContentFilterTest, MultiLiteralMatchesNaiveSearch) {
+    std::vector<std::string> literals = {"Foo", "bar", "x", "zzz"};
+    MultiLiteralSearcher searcher(literals);
+    std::mt19937 rng(42);
+    const std::string alphabet = "Fobarxz \n";
+    for(int round = 0; round < 200; round++) {
+        std::string text;
+        for(int i = 0, n = static_cast<int>(rng() % 200); i < n; i++) {
+            text.push_back(alphabet[rng() % alphabet.size()]);
+        }
+        size_t from = text.empty() ? 0 : rng() % text.size();
+        size_t expected = std::string_view::npos;
+        for(const auto& l : literals) {
+            expected = std::min(expected, std::string_view(text).find(l, from));
+        }
+        EXPECT_EQ(searcher.find(text, from), expected) << text;
+    }
+}
+
+TEST(ContentFilterTest, RequiredLiteral) {
+    EXPECT_EQ(required_literal("FooClient"), "FooClient");
+    EXPECT_EQ(required_literal("Foo(Client|Server)"), "Foo");
+    EXPECT_EQ(required_literal("get_\\w+_count"), "_count");
+    EXPECT_EQ(required_literal("colou?r_map"), "r_map");
+    EXPECT_EQ(required_literal("a\\.b\\.c"), "a.b.c");
+    EXPECT_EQ(required_literal("foo|bar"), "");
+    EXPECT_EQ(required_literal("[a-z]+"), "");
+    // Character escapes are skipped whole, not partly taken as literal text
+    EXPECT_EQ(required_literal("\\x46ooClient"), "ooClient");
+    EXPECT_EQ(required_literal("Foo\\u0043lient"), "lient");
+    EXPECT_EQ(required_literal("\\x7Bbar"), "bar");
+    EXPECT_EQ(required_literal("(a)\\1bc"), "bc");
+}
+
+TEST(ContentFilterTest, EscapedCharacters) {
+    GrepOptions options;
+    options.patterns = {"\\x46ooClient", "\\x7Bbar"};
+    ContentFilter filter;
+    std::string error;
+    ASSERT_TRUE(filter.compile(options, error)) << error;
+    std::string a = "auto c = FooClient();\n";
+    std::string b = "x = {bar};\n";
+    std::string c = "46ooClient 7Bbar\n";
+    EXPECT_TRUE(filter.apply(a));
+    EXPECT_TRUE(filter.apply(b));
+    EXPECT_FALSE(filter.apply(c));
+
+    options.patterns = {"Foo\\u0043lient"};
+    ASSERT_TRUE(filter.compile(options, error)) << error;
+    EXPECT_TRUE(filter.apply(a));
+}
+
+TEST(ContentFilterTest, WholeFiles) {
+    GrepOptions options;
+    options.patterns = {"FooClient", "make_[a-z]+\\("};
+    std::string match = "int a;\nauto c = make_client(1);\n";
+    EXPECT_TRUE(apply_filter(options, match));
+    EXPECT_EQ(match, "int a;\nauto c = make_client(1);\n");
+    std::string none = "int a;\nFooClien b;\nmake_(x);\n";
+    EXPECT_FALSE(apply_filter(options, none));
+}
+
+TEST(ContentFilterTest, HunksWithContext) {
+    std::string content;
+    for(int i = 1; i <= 20; i++) {
+        content += (i == 3 || i == 6 || i == 15) ? "call FooClient\n" : "line " + std::to_string(i) + "\n";
+    }
+    GrepOptions options;
+    options.patterns = {"Foo\\w+"};
+    options.hunks = true;
+    options.context = 1;
+    ASSERT_TRUE(apply_filter(options, content));
+    EXPECT_EQ(content,
+              "2-line 2\n"
+              "3:call FooClient\n"
+              "4-line 4\n"
+              "5-line 5\n"
+              "6:call FooClient\n"
+              "7-line 7\n"
+              "--\n"
+              "14-line 14\n"
+              "15:call FooClient\n"
+              "16-line 16\n");
+}
+
+TEST(ContentFilterTest, HunksAtFileEdges) {
+    std::string content = "hit first\nmiddle\nhit last";
+    GrepOptions options;
+    options.patterns = {"hit"};
+    options.hunks = true;
+    options.context = 5;
+    ASSERT_TRUE(apply_filter(options, content));
+    EXPECT_EQ(content, "1:hit first\n2-middle\n3:hit last\n");
+}
+
+TEST(ContentFilterTest, InvalidRegex) {
+    ContentFilter filter;
+    std::string error;
+    GrepOptions options;
+    options.patterns = {"foo("};
+    EXPECT_FALSE(filter.compile(options, error));
+    EXPECT_FALSE(error.empty());
+}
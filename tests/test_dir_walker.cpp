@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include "dir_walker.hpp"
+#include "test_util.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <map>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Walk root and return relative path -> content
+std::map<std::string, std::string> walk_and_read(const fs::path& root, SymlinkPolicy symlinks,
+                                                 const std::string& skipped_dir = "") {
+    std::map<std::string, std::string> files;
+    auto wr = walk_directory(
+        root, symlinks,
+        [&](std::string_view dir) { return dir == skipped_dir; },
+        [&](const WalkEntry& entry) {
+            std::string content;
+            EXPECT_TRUE(read_walk_entry(entry, ReadLimits{}, content)) << entry.path;
+            files.emplace(std::string(entry.path), std::move(content));
+        });
+    EXPECT_TRUE(wr.ok) << wr.error_msg;
+    return files;
+}
+
+std::vector<std::string> keys(const std::map<std::string, std::string>& m) {
+    std::vector<std::string> v;
+    for(const auto& [k, _] : m) v.push_back(k);
+    return v;
+}
+
+class DirWalkerTest : public TempDirTest {
+protected:
+    void SetUp() override {
+        TempDirTest::SetUp();
+        root = dir / "root";
+        write_file(root / "a.txt", "alpha");
+        write_file(root / "src/b.cpp", "beta");
+        write_file(root / "src/deep/c.h", "gamma");
+        write_file(root / "build/out.o", "object");
+        write_file(dir / "outside/d.txt", "delta");
+    }
+    bool make_links() {
+        std::error_code ec;
+        fs::create_symlink("a.txt", root / "link.txt", ec);
+        if(ec) return false;
+        fs::create_directory_symlink("../../outside", root / "src/ext", ec);
+        fs::create_directory_symlink("..", root / "src/deep/up", ec);
+        return !ec;
+    }
+    fs::path root;
+};
+
+} // namespace
+
+TEST_F(DirWalkerTest, ListsAndReadsRegularFiles) {
+    auto files = walk_and_read(root, SymlinkPolicy::Files);
+    std::vector<std::string> expected = {"a.txt", "build/out.o", "src/b.cpp", "src/deep/c.h"};
+    EXPECT_EQ(keys(files), expected);
+    EXPECT_EQ(files["src/deep/c.h"], "gamma");
+}
+
+TEST_F(DirWalkerTest, SkipDirPrunesSubtree) {
+    auto files = walk_and_read(root, SymlinkPolicy::Files, "build");
+    std::vector<std::string> expected = {"a.txt", "src/b.cpp", "src/deep/c.h"};
+    EXPECT_EQ(keys(files), expected);
+}
+
+TEST_F(DirWalkerTest, SymlinkPolicies) {
+    if(!make_links()) {
+        GTEST_SKIP() << "symlinks not supported";
+    }
+    std::vector<std::string> skip = {"a.txt", "build/out.o", "src/b.cpp", "src/deep/c.h"};
+    EXPECT_EQ(keys(walk_and_read(root, SymlinkPolicy::Skip)), skip);
+
+    std::vector<std::string> files = {"a.txt", "build/out.o", "link.txt", "src/b.cpp", "src/deep/c.h"};
+    auto with_files = walk_and_read(root, SymlinkPolicy::Files);
+    EXPECT_EQ(keys(with_files), files);
+    EXPECT_EQ(with_files["link.txt"], "alpha");
+
+    // src/deep/up points back to src: followed links to an ancestor are not entered
+    std::vector<std::string> follow = {"a.txt", "build/out.o", "link.txt", "src/b.cpp",
+                                       "src/deep/c.h", "src/ext/d.txt"};
+    auto followed = walk_and_read(root, SymlinkPolicy::Follow);
+    EXPECT_EQ(keys(followed), follow);
+    EXPECT_EQ(followed["src/ext/d.txt"], "delta");
+}
+
+TEST_F(DirWalkerTest, MissingRootFails) {
+    auto wr = walk_directory(root / "missing", SymlinkPolicy::Files,
+                             [](std::string_view) { return false; }, [](const WalkEntry&) {});
+    EXPECT_FALSE(wr.ok);
+}
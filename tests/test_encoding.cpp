@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include "encoding.hpp"
+
+TEST(EncodingTest, DetectBomAndHeuristics) {
+    EXPECT_EQ(detect_encoding("\xEF\xBB\xBFhello").bom_size, 3u);
+    EXPECT_EQ(detect_encoding(std::string_view("\xFF\xFEh\0i\0", 6)).encoding, TextEncoding::Utf16LE);
+    EXPECT_EQ(detect_encoding(std::string_view("h\0i\0!\0", 6)).encoding, TextEncoding::Utf16LE);
+    EXPECT_EQ(detect_encoding(std::string_view("\0h\0i\0!", 6)).encoding, TextEncoding::Utf16BE);
+    EXPECT_EQ(detect_encoding("caf\xC3\xA9").encoding, TextEncoding::Utf8);
+    EXPECT_EQ(detect_encoding("caf\xE9 cr\xE8me").encoding, TextEncoding::Latin1);
+}
+
+TEST(EncodingTest, DetectToleratesCutSequences) {
+    // Excerpts may start or end inside a character, whatever their length
+    EXPECT_EQ(detect_encoding("\xA9 caf\xC3\xA9").encoding, TextEncoding::Utf8);
+    EXPECT_EQ(detect_encoding("\x82\xAC euro").encoding, TextEncoding::Utf8);
+    EXPECT_EQ(detect_encoding("caf\xC3\xA9 caf\xC3").encoding, TextEncoding::Utf8);
+    EXPECT_EQ(detect_encoding("euro \xE2\x82").encoding, TextEncoding::Utf8);
+    EXPECT_EQ(detect_encoding("caf\xE9 \xA9").encoding, TextEncoding::Latin1);
+    EXPECT_EQ(detect_encoding("euro \xE2\x82 x").encoding, TextEncoding::Latin1);
+}
+
+TEST(EncodingTest, ValidateUtf8) {
+    EXPECT_TRUE(is_valid_utf8(""));
+    EXPECT_TRUE(is_valid_utf8("plain ASCII text that is longer than sixteen bytes"));
+    EXPECT_TRUE(is_valid_utf8("\xE2\x82\xAC and \xF0\x9F\x98\x80 after a long ASCII prefix......"));
+    EXPECT_FALSE(is_valid_utf8("overlong \xC0\xAF"));
+    EXPECT_FALSE(is_valid_utf8("surrogate \xED\xA0\x80"));
+    EXPECT_FALSE(is_valid_utf8("too large \xF4\x90\x80\x80"));
+    EXPECT_FALSE(is_valid_utf8("truncated at the very end of a long buffer \xE2\x82"));
+}
+
+TEST(EncodingTest, ValidUtf8IsUnchanged) {
+    std::string content = "int main() { return 0; } // \xC3\xA9t\xC3\xA9\n";
+    std::string copy = content;
+    EXPECT_TRUE(normalize_encoding(content, EncodingPolicy::Skip));
+    EXPECT_EQ(content, copy);
+
+    std::string bom = "\xEF\xBB\xBFx = 1\n";
+    EXPECT_TRUE(normalize_encoding(bom, EncodingPolicy::Transcode));
+    EXPECT_EQ(bom, "x = 1\n");
+}
+
+TEST(EncodingTest, TranscodeUtf16) {
+    // "key = é€\U0001F600\n" repeated so the vectorized ASCII path is used too
+    std::u16string text;
+    std::string expected;
+    for(int i = 0; i < 3; i++) {
+        text += u"some ASCII key = é€\U0001F600\n";
+        expected += "some ASCII key = \xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\n";
+    }
+    std::string le = "\xFF\xFE", be = "\xFE\xFF";
+    for(char16_t u : text) {
+        le.push_back(static_cast<char>(u & 0xFF));
+        le.push_back(static_cast<char>(u >> 8));
+        be.push_back(static_cast<char>(u >> 8));
+        be.push_back(static_cast<char>(u & 0xFF));
+    }
+    EXPECT_TRUE(normalize_encoding(le, EncodingPolicy::Transcode));
+    EXPECT_EQ(le, expected);
+    EXPECT_TRUE(normalize_encoding(be, EncodingPolicy::Replace));
+    EXPECT_EQ(be, expected);
+
+    std::string skipped("\xFF\xFEh\0i\0", 6);
+    EXPECT_FALSE(normalize_encoding(skipped, EncodingPolicy::Skip));
+}
+
+TEST(EncodingTest, Latin1Policies) {
+    const std::string latin1 = "// caf\xE9 \x80 na\xEFve\n";
+    std::string transcoded = latin1;
+    EXPECT_TRUE(normalize_encoding(transcoded, EncodingPolicy::Transcode));
+    EXPECT_EQ(transcoded, "// caf\xC3\xA9 \xE2\x82\xAC na\xC3\xAFve\n");
+
+    std::string replaced = latin1;
+    EXPECT_TRUE(normalize_encoding(replaced, EncodingPolicy::Replace));
+    EXPECT_EQ(replaced, "// caf\xEF\xBF\xBD \xEF\xBF\xBD na\xEF\xBF\xBDve\n");
+
+    std::string skipped = latin1;
+    EXPECT_FALSE(normalize_encoding(skipped, EncodingPolicy::Skip));
+}
+
+TEST(EncodingTest, StrayBytesAfterFirstBlock) {
+    // Valid UTF-8 in the first block, one Latin-1 byte later on
+    std::string content(5000, 'a');
+    content += "\xC3\xA9 \xE9";
+    EXPECT_EQ(detect_encoding(content).encoding, TextEncoding::Utf8);
+    EXPECT_TRUE(normalize_encoding(content, EncodingPolicy::Transcode));
+    EXPECT_EQ(content, std::string(5000, 'a') + "\xC3\xA9 \xC3\xA9");
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+#include "file_reader.hpp"
+#include "test_util.hpp"
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+class FileReaderTest : public TempDirTest {
+protected:
+    fs::path write_temp(const std::string& name, const std::string& content) {
+        write_file(dir / name, content);
+        return dir / name;
+    }
+};
+
+static std::string numbered_lines(int n) {
+    std::string s;
+    for(int i = 1; i <= n; i++) {
+        s += "line " + std::to_string(i) + "\n";
+    }
+    return s;
+}
+
+TEST_F(FileReaderTest, NoLimitsReadsWholeFile) {
+    auto content = numbered_lines(100);
+    auto path = write_temp("full.txt", content);
+    std::string out;
+    ASSERT_TRUE(read_file_limited(path, ReadLimits{}, out));
+    EXPECT_EQ(out, content);
+}
+
+TEST_F(FileReaderTest, HeadLines) {
+    auto path = write_temp("head.txt", numbered_lines(10));
+    ReadLimits limits;
+    limits.max_lines = 3;
+    std::string out;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, "line 1\nline 2\nline 3\n[... 50 bytes omitted ...]\n");
+}
+
+TEST_F(FileReaderTest, TailLinesWithoutTrailingNewline) {
+    auto path = write_temp("tail.txt", "a\nb\nc\nd");
+    ReadLimits limits;
+    limits.max_lines = 2;
+    limits.policy = TruncatePolicy::Tail;
+    std::string out;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, "[... 4 bytes omitted ...]\nc\nd");
+}
+
+TEST_F(FileReaderTest, HeadTailBytesAlignToLines) {
+    // Large enough to span several read blocks.
+    auto content = numbered_lines(50000);
+    auto path = write_temp("headtail.txt", content);
+    ReadLimits limits;
+    limits.max_bytes = 48;
+    limits.policy = TruncatePolicy::HeadTail;
+    std::string out;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out.rfind("line 1\nline 2\nline 3\n[... ", 0), 0u);
+    EXPECT_NE(std::string::npos, out.find("bytes omitted ...]\nline 49999\nline 50000\n"));
+}
+
+TEST_F(FileReaderTest, SmallFileIsNotTruncated) {
+    auto content = numbered_lines(4);
+    auto path = write_temp("small.txt", content);
+    ReadLimits limits;
+    limits.max_lines = 4;
+    limits.policy = TruncatePolicy::HeadTail;
+    std::string out;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, content);
+}
+
+TEST_F(FileReaderTest, ByteCutsKeepWholeUtf8Characters) {
+    std::string text;
+    for(int i = 0; i < 200; i++) {
+        text += "\xC3\xA9";
+    }
+    auto path = write_temp("multibyte.txt", text);
+    std::string kept;
+    for(int i = 0; i < 25; i++) {
+        kept += "\xC3\xA9";
+    }
+    ReadLimits limits;
+    limits.max_bytes = 51;
+    std::string out;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, kept + "\n[... 350 bytes omitted ...]\n");
+
+    limits.policy = TruncatePolicy::Tail;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, "[... 350 bytes omitted ...]\n" + kept);
+}
+
+TEST_F(FileReaderTest, Utf16IsCutOnCodeUnits) {
+    auto text = numbered_lines(10);
+    std::string utf16 = "\xFF\xFE";
+    for(char c : text) {
+        utf16.push_back(c);
+        utf16.push_back('\0');
+    }
+    auto path = write_temp("utf16.txt", utf16);
+    ReadLimits limits;
+    limits.max_lines = 4;
+    limits.encoding = EncodingPolicy::Transcode;
+    std::string out;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, "line 1\nline 2\nline 3\nline 4\n[... 86 bytes omitted ...]\n");
+
+    limits.policy = TruncatePolicy::HeadTail;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, "line 1\nline 2\n[... 84 bytes omitted ...]\nline 9\nline 10\n");
+
+    // An odd byte limit is rounded down to whole code units
+    limits.max_lines = 0;
+    limits.max_bytes = 21;
+    limits.policy = TruncatePolicy::Head;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, "line 1\n[... 128 bytes omitted ...]\n");
+
+    limits.policy = TruncatePolicy::Tail;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, "[... 128 bytes omitted ...]\nline 10\n");
+}
+
+TEST_F(FileReaderTest, Latin1IsCutBeforeConverting) {
+    auto path = write_temp("latin1.txt", "caf\xE9 1\ncaf\xE9 2\ncaf\xE9 3\n");
+    ReadLimits limits;
+    limits.max_bytes = 10;
+    limits.encoding = EncodingPolicy::Transcode;
+    std::string out;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, "caf\xC3\xA9 1\n[... 14 bytes omitted ...]\n");
+
+    limits.policy = TruncatePolicy::Tail;
+    ASSERT_TRUE(read_file_limited(path, limits, out));
+    EXPECT_EQ(out, "[... 14 bytes omitted ...]\ncaf\xC3\xA9 3\n");
+}
+
+TEST_F(FileReaderTest, SkipPolicyReturnsNothing) {
+    auto path = write_temp("skip.txt", "caf\xE9 1\ncaf\xE9 2\ncaf\xE9 3\n");
+    ReadLimits limits;
+    limits.encoding = EncodingPolicy::Skip;
+    std::string out;
+    bool skipped = false;
+    ASSERT_TRUE(read_file_limited(path, limits, out, &skipped));
+    EXPECT_TRUE(skipped);
+    EXPECT_TRUE(out.empty());
+
+    limits.max_lines = 1;
+    skipped = false;
+    ASSERT_TRUE(read_file_limited(path, limits, out, &skipped));
+    EXPECT_TRUE(skipped);
+    EXPECT_TRUE(out.empty());
+}
+
+TEST_F(FileReaderTest, TruncateContentInMemory) {
+    std::string content = numbered_lines(10);
+    ReadLimits limits;
+    limits.max_lines = 2;
+    limits.policy = TruncatePolicy::Tail;
+    truncate_content(content, limits);
+    EXPECT_EQ(content, "[... 56 bytes omitted ...]\nline 9\nline 10\n");
+
+    std::string small = "a\nb\n";
+    limits.max_lines = 5;
+    truncate_content(small, limits);
+    EXPECT_EQ(small, "a\nb\n");
+}
@@ -0,0 +1,158 @@
+#include <gtest/gtest.h>
+#include "git_changes.hpp"
+#include "test_util.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/// Run git in repo; its output goes to git.log next to the repository
+bool git(const fs::path& repo, const std::string& args) {
+    std::string cmd = "git -C \"" + repo.string() + "\" -c user.name=test -c user.email=test@example.com "
+                    + "-c core.autocrlf=false " + args + " > \"" + (repo.parent_path() / "git.log").string() + "\" 2>&1";
+    return std::system(cmd.c_str()) == 0;
+}
+
+bool contains(const std::vector<std::string>& v, const std::string& s) {
+    return std::find(v.begin(), v.end(), s) != v.end();
+}
+
+class GitChangesTest : public TempDirTest {
+protected:
+    void SetUp() override {
+        TempDirTest::SetUp();
+        repo = dir / "repo";
+        fs::create_directories(repo);
+        if(!git(repo, "init -q")) {
+            GTEST_SKIP() << "git is not available";
+        }
+        write_file(repo / "src/a.cpp", "int a = 1;\n");
+        write_file(repo / "src/b.cpp", "int b = 2;\n");
+        write_file(repo / "src/deep/c.cpp", "int c = 3;\n");
+        write_file(repo / "docs/readme.md", "docs\n");
+        ASSERT_TRUE(git(repo, "add -A"));
+        ASSERT_TRUE(git(repo, "commit -q -m initial"));
+    }
+
+    fs::path repo;
+};
+
+} // namespace
+
+TEST(GitObjectsTest, HashBlob) {
+    EXPECT_EQ(oid_to_hex(hash_blob("")), "e69de29bb2d1d6434b8b29ae775ad8c2e48c5391");
+    EXPECT_EQ(oid_to_hex(hash_blob("hello\n")), "ce013625030ba8dba906f756967f9e9ca394464a");
+}
+
+TEST_F(GitChangesTest, CleanTreeHasNoChanges) {
+    auto result = find_changed_files(repo.string(), "", 0, {".git/**"});
+    ASSERT_TRUE(result.ok) << result.error_msg;
+    EXPECT_TRUE(result.changed.empty());
+}
+
+TEST_F(GitChangesTest, ModifiedAndUntrackedFiles) {
+    write_file(repo / "src/a.cpp", "int a = 9;\n");   // same size, different content
+    write_file(repo / "src/new.cpp", "new\n");
+    write_file(repo / "build/out.o", "binary\n");
+
+    auto result = find_changed_files(repo.string(), "", 2, {".git/**", "build/**"});
+    ASSERT_TRUE(result.ok) << result.error_msg;
+    EXPECT_EQ(result.changed, (std::vector<std::string>{"src/a.cpp", "src/new.cpp"}));
+    // Closest unchanged files: the sibling first, then the subdirectory
+    EXPECT_EQ(result.context, (std::vector<std::string>{"src/b.cpp", "src/deep/c.cpp"}));
+}
+
+TEST_F(GitChangesTest, UntrackedFilesInNestedDirectories) {
+    write_file(repo / "src/deep/new.h", "new\n");
+    write_file(repo / "src-old/a.cpp", "old\n");   // sorts next to the tracked src/ entries
+    write_file(repo / "tools/gen/run.sh", "run\n");
+    write_file(repo / "tools/gen/cache/x.bin", "x\n");
+
+    auto result = find_changed_files(repo.string(), "", 0, {".git/**", "tools/gen/cache/**"});
+    ASSERT_TRUE(result.ok) << result.error_msg;
+    EXPECT_EQ(result.changed, (std::vector<std::string>{"src-old/a.cpp", "src/deep/new.h", "tools/gen/run.sh"}));
+}
+
+TEST_F(GitChangesTest, UntrackedFilesFollowGitIgnoreRules) {
+    write_file(repo / ".gitignore", "*.o\n/dist\n__pycache__/\n!keep.o\nlogs/**/*.log\n");
+    write_file(repo / "src/.gitignore", "local.txt\n/gen/\n");
+    write_file(repo / ".git/info/exclude", "secret.txt\n");
+    for(const char* path : {"src/a.o", "src/keep.o", "src/__pycache__/m.pyc", "dist/bundle.js",
+                            "src/dist/x.js", "src/local.txt", "docs/local.txt", "src/gen/g.cpp",
+                            "gen/g.cpp", "logs/a/b.log", "logs/a/b.txt", "secret.txt",
+                            "src/deep/new.cpp", "__pycache__"}) {
+        write_file(repo / path, "x\n");
+    }
+
+    // What Git reports as untracked ("?? path" lines)
+    std::vector<std::string> expected;
+    std::string cmd = "git -C \"" + repo.string() + "\" status --porcelain --untracked-files=all";
+    FILE* pipe = popen(cmd.c_str(), "r");
+    ASSERT_NE(pipe, nullptr);
+    char buf[4096];
+    while(std::fgets(buf, sizeof(buf), pipe)) {
+        std::string line(buf);
+        if(!line.empty() && line.back() == '\n') line.pop_back();
+        if(line.rfind("?? ", 0) == 0) expected.push_back(line.substr(3));
+    }
+    pclose(pipe);
+    std::sort(expected.begin(), expected.end());
+    ASSERT_FALSE(expected.empty());
+
+    auto result = find_changed_files(repo.string(), "", 0, {".git/**"});
+    ASSERT_TRUE(result.ok) << result.error_msg;
+    EXPECT_EQ(result.changed, expected);
+}
+
+TEST_F(GitChangesTest, CompareAgainstRevision) {
+    if(!GitObjectStore::available()) {
+        GTEST_SKIP() << "built without zlib";
+    }
+    write_file(repo / "src/b.cpp", "int b = 20;\n");
+    write_file(repo / "docs/new.md", "more docs\n");
+    ASSERT_TRUE(git(repo, "add -A"));
+    ASSERT_TRUE(git(repo, "commit -q -m second"));
+    ASSERT_TRUE(git(repo, "gc -q"));   // exercise pack files
+
+    auto clean = find_changed_files(repo.string(), "HEAD", 0, {".git/**"});
+    ASSERT_TRUE(clean.ok) << clean.error_msg;
+    EXPECT_TRUE(clean.changed.empty());
+
+    auto result = find_changed_files(repo.string(), "HEAD~1", 0, {".git/**"});
+    ASSERT_TRUE(result.ok) << result.error_msg;
+    EXPECT_EQ(result.changed, (std::vector<std::string>{"docs/new.md", "src/b.cpp"}));
+    EXPECT_FALSE(contains(result.changed, "src/a.cpp"));
+}
+
+TEST_F(GitChangesTest, CorruptCacheTreeIsIgnored) {
+    auto make_index = [](const std::string& tree) {
+        std::string raw("DIRC\0\0\0\2\0\0\0\0", 12);
+        const uint32_t len = static_cast<uint32_t>(tree.size());
+        raw += "TREE";
+        for(int shift = 24; shift >= 0; shift -= 8) {
+            raw.push_back(static_cast<char>((len >> shift) & 0xff));
+        }
+        raw += tree;
+        raw.append(20, '\0');   // checksum
+        return raw;
+    };
+    const std::string bad_counts[] = {"99999999999999999999 0\n", "x 0\n", "1x 0\n", "-1 y\n"};
+    for(const auto& counts : bad_counts) {
+        write_file(repo / "corrupt.index", make_index(std::string(1, '\0') + counts));
+        auto index = read_git_index(repo / "corrupt.index");
+        EXPECT_TRUE(index.ok) << index.error_msg;
+        EXPECT_TRUE(index.cache_tree.empty()) << counts;
+    }
+}
+
+TEST_F(GitChangesTest, OutOfRangeRevisionIsAnError) {
+    if(!GitObjectStore::available()) {
+        GTEST_SKIP() << "built without zlib";
+    }
+    auto result = find_changed_files(repo.string(), "HEAD~99999999999999999999", 0, {".git/**"});
+    EXPECT_FALSE(result.ok);
+}
@@ -0,0 +1,20 @@
+#include <gtest/gtest.h>
+#include "git_ignore.hpp"
+
+TEST(GitIgnoreTest, GlobMatch) {
+    EXPECT_TRUE(gitignore_glob_match("*.o", "a.o"));
+    EXPECT_FALSE(gitignore_glob_match("*.o", "src/a.o"));   // '*' stops at '/'
+    EXPECT_TRUE(gitignore_glob_match("doc/*.txt", "doc/notes.txt"));
+    EXPECT_FALSE(gitignore_glob_match("doc/*.txt", "doc/sub/notes.txt"));
+    EXPECT_TRUE(gitignore_glob_match("**/build", "build"));
+    EXPECT_TRUE(gitignore_glob_match("**/build", "a/b/build"));
+    EXPECT_TRUE(gitignore_glob_match("logs/**", "logs/a/b.log"));
+    EXPECT_TRUE(gitignore_glob_match("a/**/b", "a/b"));
+    EXPECT_TRUE(gitignore_glob_match("a/**/b", "a/x/y/b"));
+    EXPECT_FALSE(gitignore_glob_match("a/**/b", "a/x/c"));
+    EXPECT_TRUE(gitignore_glob_match("file?.[ch]", "file1.c"));
+    EXPECT_FALSE(gitignore_glob_match("file?.[!ch]", "file1.c"));
+    EXPECT_TRUE(gitignore_glob_match("v[0-9]", "v7"));
+    EXPECT_TRUE(gitignore_glob_match("\\*star", "*star"));
+    EXPECT_FALSE(gitignore_glob_match("\\*star", "xstar"));
+}
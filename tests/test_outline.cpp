@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include "outline.hpp"
+
+TEST(OutlineTest, DetectLanguage) {
+    EXPECT_EQ(detect_language("src/main.cpp"), SourceLanguage::CFamily);
+    EXPECT_EQ(detect_language("lib/mod.rs"), SourceLanguage::Rust);
+    EXPECT_EQ(detect_language("app/view.TSX"), SourceLanguage::JavaScript);
+    EXPECT_EQ(detect_language("tool.py"), SourceLanguage::Python);
+    EXPECT_EQ(detect_language("README.md"), SourceLanguage::Unknown);
+}
+
+TEST(OutlineTest, CppKeepsDeclarationsAndDropsBodies) {
+    std::string code =
+        "#include <string>\n"
+        "/**\n"
+        " * A widget.\n"
+        " * Longer description.\n"
+        " */\n"
+        "class Widget : public Base {\n"
+        "public:\n"
+        "    int size() const { return s_.size() + '}'; }\n"
+        "    void draw();\n"
+        "private:\n"
+        "    std::string s_ = \"{\";\n"
+        "};\n"
+        "void Widget::draw() {\n"
+        "    if(x) { y(); }\n"
+        "}\n";
+    std::string expected =
+        "#include <string>\n"
+        "/** A widget. */\n"
+        "class Widget : public Base {\n"
+        "public:\n"
+        "    int size() const { ... }\n"
+        "    void draw();\n"
+        "private:\n"
+        "    std::string s_ = \"{\";\n"
+        "};\n"
+        "void Widget::draw() { ... }\n";
+    EXPECT_EQ(outline_source(code, SourceLanguage::CFamily), expected);
+}
+
+TEST(OutlineTest, RustAndGo) {
+    std::string rust =
+        "/// Adds numbers.\n"
+        "/// Second line.\n"
+        "pub fn add<'a>(a: &'a i32) -> i32 {\n"
+        "    let s = r#\"}\"#;\n"
+        "    *a\n"
+        "}\n"
+        "impl Foo {\n"
+        "    fn get(&self) -> u8 { self.0 }\n"
+        "}\n";
+    EXPECT_EQ(outline_source(rust, SourceLanguage::Rust),
+              "/// Adds numbers.\n"
+              "pub fn add<'a>(a: &'a i32) -> i32 { ... }\n"
+              "impl Foo {\n"
+              "    fn get(&self) -> u8 { ... }\n"
+              "}\n");
+
+    std::string go =
+        "type Point struct {\n\tX int\n}\n"
+        "func (p Point) Len() int {\n\treturn `}`\n}\n";
+    EXPECT_EQ(outline_source(go, SourceLanguage::Go),
+              "type Point struct {\n\tX int\n}\n"
+              "func (p Point) Len() int { ... }\n");
+}
+
+TEST(OutlineTest, Python) {
+    std::string code =
+        "\"\"\"Module doc.\n\nMore.\n\"\"\"\n"
+        "import os\n"
+        "class A(Base):\n"
+        "    \"\"\"Class doc.\"\"\"\n"
+        "    x = 1\n"
+        "    @property\n"
+        "    def f(self,\n"
+        "          y):\n"
+        "        \"\"\"Summary.\n\n        Details.\n        \"\"\"\n"
+        "        return {\n"
+        "            'a': 1}\n"
+        "\n"
+        "    def g(self): return 2\n";
+    std::string expected =
+        "\"\"\"Module doc.\"\"\"\n"
+        "import os\n"
+        "class A(Base):\n"
+        "    \"\"\"Class doc.\"\"\"\n"
+        "    x = 1\n"
+        "    @property\n"
+        "    def f(self,\n"
+        "          y):\n"
+        "        \"\"\"Summary.\"\"\"\n"
+        "        ...\n"
+        "\n"
+        "    def g(self): return 2\n";
+    EXPECT_EQ(outline_source(code, SourceLanguage::Python), expected);
+}
+
+TEST(OutlineTest, ContainerHeadersWithParentheses) {
+    std::string cpp =
+        "struct __attribute__((packed)) Hdr {\n    int a;\n};\n"
+        "class alignas(16) Vec {\n    float x() const { return x_; }\n};\n"
+        "struct S* make(int n) {\n    return nullptr;\n}\n";
+    EXPECT_EQ(outline_source(cpp, SourceLanguage::CFamily),
+              "struct __attribute__((packed)) Hdr {\n    int a;\n};\n"
+              "class alignas(16) Vec {\n    float x() const { ... }\n};\n"
+              "struct S* make(int n) { ... }\n");
+
+    std::string kotlin = "class Foo(val x: Int) {\n    fun twice(): Int { return x * 2 }\n}\n";
+    EXPECT_EQ(outline_source(kotlin, SourceLanguage::Java),
+              "class Foo(val x: Int) {\n    fun twice(): Int { ... }\n}\n");
+
+    std::string java = "public record Point(int x, int y) {\n    int sum() { return x + y; }\n}\n";
+    EXPECT_EQ(outline_source(java, SourceLanguage::Java),
+              "public record Point(int x, int y) {\n    int sum() { ... }\n}\n");
+
+    std::string rust = "impl<F: Fn(u8)> Handler for Wrap<F> {\n    fn call(&self) { (self.0)(1) }\n}\n";
+    EXPECT_EQ(outline_source(rust, SourceLanguage::Rust),
+              "impl<F: Fn(u8)> Handler for Wrap<F> {\n    fn call(&self) { ... }\n}\n");
+}
+
+TEST(OutlineTest, TypeScriptObjectReturnType) {
+    std::string ts = "function f(): { a: number } {\n    return { a: 1 };\n}\n";
+    EXPECT_EQ(outline_source(ts, SourceLanguage::JavaScript), "function f(): { a: number } { ... }\n");
+}
+
+TEST(OutlineTest, ConstructorBraceInitializers) {
+    std::string cpp =
+        "Foo::Foo(int x) : a_(x), b_{x} {\n    body();\n}\n"
+        "Derived(int x) : Base{x} {}\n"
+        "Bar::Bar() : v_{1, 2}, w_{std::vector<int>{3}} { init(); }\n";
+    EXPECT_EQ(outline_source(cpp, SourceLanguage::CFamily),
+              "Foo::Foo(int x) : a_(x), b_{x} { ... }\n"
+              "Derived(int x) : Base{x} { ... }\n"
+              "Bar::Bar() : v_{1, 2}, w_{std::vector<int>{3}} { ... }\n");
+}
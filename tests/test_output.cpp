@@ -27,3 +27,19 @@ TEST(OutputTest, FormatJsonBasic) {
     EXPECT_NE(std::string::npos, result.data.find("\"token_estimate\""));
     EXPECT_GT(result.tokens, 0);
 }
+
+TEST(OutputTest, ScrubKeepsGrepHunkSeparators) {
+    std::vector<FileInfo> files{
+        {"a.sql", "2:select 1; -- one\n--\n9:select 2;\n", true},
+        {"b.sql", "-- comment\nselect 3;\n"}
+    };
+    auto result = format_text(files, "", true, false);
+    EXPECT_NE(std::string::npos, result.data.find("2:select 1; -- one\n--\n9:select 2;\n"));
+    EXPECT_EQ(std::string::npos, result.data.find("-- comment"));
+}
+
+TEST(OutputTest, ContentTokensCountTransformedText) {
+    FileInfo f{"a.cpp", "// one two three\nint x;\n"};
+    EXPECT_EQ(content_token_count(f, false, false), 6);
+    EXPECT_EQ(content_token_count(f, true, false), 2);
+}
@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "comment_scrub.hpp"
+#include "output_formatter.hpp"
+#include "token_count.hpp"
+#include "transform_pipeline.hpp"
+
+TEST(PipelineTest, RemoveComments) {
+    std::string code = "int a; // trailing\n"
+                       "/* block\n   spans */ int b;\n"
+                       "  # shell comment\n"
+                       "-- sql comment\n"
+                       "x--y;\n"
+                       "<!-- html -->ok\n"
+                       "a / b < c";
+    EXPECT_EQ(remove_comments(code), "int a; \n int b;\nx--y;\nok\na / b < c\n");
+}
+
+TEST(PipelineTest, MinifyWhitespace) {
+    std::string out;
+    TokenCounter counter;
+    TransformPipeline<false, true, EscapeMode::Raw, false> p(out, counter);
+    p.content("\n\nfoo  \n\n\n\n    bar\t\n\n");
+    EXPECT_EQ(out, "foo\n\n    bar\n");
+}
+
+TEST(PipelineTest, JsonEscape) {
+    std::string out;
+    TokenCounter counter;
+    TransformPipeline<false, false, EscapeMode::Json, true> p(out, counter);
+    p.content("a \"q\"\\\n\t\x01");
+    EXPECT_EQ(out, "a \\\"q\\\"\\\\\\n\\t\\u0001");
+    EXPECT_EQ(counter.count, 2);
+}
+
+TEST(PipelineTest, FusedCountMatchesRecount) {
+    std::vector<FileInfo> files{
+        {"src/main.cpp", "int main() {\n  // hi\n  return 0;\n}\n"},
+        {"notes.txt", "# heading\nsome   words here\n\n\n"}
+    };
+    for(bool scrub : {false, true}) {
+        for(bool minify : {false, true}) {
+            auto text = format_text(files, "", scrub, true, minify);
+            EXPECT_EQ(text.tokens, approximate_token_count(text.data));
+        }
+    }
+}
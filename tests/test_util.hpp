@@ -0,0 +1,57 @@
+#pragma once
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+#include <process.h>
+#define G2P_TEST_PID _getpid()
+#else
+#include <unistd.h>
+#define G2P_TEST_PID getpid()
+#endif
+
+/// Write a file, creating its parent directories
+inline void write_file(const std::filesystem::path& path, const std::string& content) {
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << content;
+}
+
+/**
+ * @brief A temporary directory path unique to the running test: its suite and
+ *        name plus the process id, so parallel runs (ctest -j) don't collide.
+ */
+inline std::filesystem::path unique_temp_dir() {
+    const auto* info = ::testing::UnitTest::GetInstance()->current_test_info();
+    std::string name = "g2p_";
+    if(info) {
+        name += std::string(info->test_suite_name()) + "_" + info->name() + "_";
+    }
+    name += std::to_string(G2P_TEST_PID);
+    std::replace(name.begin(), name.end(), '/', '_');   // parameterized tests
+    return std::filesystem::temp_directory_path() / name;
+}
+
+/**
+ * @brief Fixture giving each test a fresh, empty directory (dir), removed in
+ *        TearDown().
+ */
+class TempDirTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir = unique_temp_dir();
+        std::filesystem::remove_all(dir);
+        std::filesystem::create_directories(dir);
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+    }
+
+    std::filesystem::path dir;
+};